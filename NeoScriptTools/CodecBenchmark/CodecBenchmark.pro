@@ -0,0 +1,21 @@
+# ----------------------------------------------------
+# Round trips debugger messages through CJSScriptDebuggerCodec and QJsonDocument,
+# reports sizes and timings and fails when a message does not survive the codec.
+# Run with an optional iteration count: CodecBenchmark [iterations]
+# ----------------------------------------------------
+
+TEMPLATE = app
+TARGET = CodecBenchmark
+QT = core
+CONFIG += console
+CONFIG -= app_bundle
+DEFINES += NEOSCRIPTTOOLS_LIB # the codec is compiled in, not imported from the library
+INCLUDEPATH += .
+DEPENDPATH += .
+
+CONFIG(debug, debug|release):DESTDIR = ../../Debug
+CONFIG(release, debug|release):DESTDIR = ../../Release
+
+HEADERS += ../JSDebugging/JSScriptDebuggerCodec.h
+SOURCES += ../JSDebugging/JSScriptDebuggerCodec.cpp \
+    ./main.cpp
@@ -0,0 +1,218 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 NeoLoader Team
+** All rights reserved.
+** Contact: XanatosDavid@gmil.com
+**
+** This file is part of the NeoScriptTools module for NeoLoader
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation and
+** appearing in the file LICENSE.LGPL included in the packaging of this
+** file. Please review the following information to ensure the GNU Lesser
+** General Public License version 2.1 requirements will be met:
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+**
+**
+****************************************************************************/
+
+// Round trips representative pause payloads through CJSScriptDebuggerCodec and QJsonDocument,
+// fails when a payload does not survive the codec and reports the encoded sizes and timings of both.
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../JSDebugging/JSScriptDebuggerCodec.h"
+
+static QVariantMap makeProperty(int i)
+{
+	QVariantMap Value;
+	QVariantMap Property;
+	switch (i % 4)
+	{
+	case 0:	Value["type"] = "NumberValue"; Value["value"] = i * 1.5; break;
+	case 1:	Value["type"] = "StringValue"; Value["value"] = QString("value of property %1").arg(i); break;
+	case 2:	Value["type"] = "BooleanValue"; Value["value"] = (i & 8) != 0; break;
+	case 3:	Value["type"] = "ObjectValue"; Value["value"] = (quint64(1) << 40) + i; break; // a handle, ref and generation
+	}
+	Property["name"] = QString("property%1").arg(i);
+	Property["value"] = Value;
+	Property["valueAsString"] = Value["value"].toString();
+	Property["flags"] = 0;
+	return Property;
+}
+
+// the event sent when the engine hits a breakpoint
+static QVariant pauseEvent()
+{
+	QVariantMap Attributes;
+	Attributes["scriptId"] = qint64(42);
+	Attributes["fileName"] = "qrc:/scripts/main.js";
+	Attributes["lineNumber"] = 117;
+	Attributes["columnNumber"] = 0;
+	QVariantMap Event;
+	Event["type"] = "Breakpoint";
+	Event["attributes"] = Attributes;
+	QVariantMap Message;
+	Message["Event"] = Event;
+	return Message;
+}
+
+// the reply to GetBacktrace
+static QVariant backtraceResult(int frames)
+{
+	QStringList Backtrace;
+	for (int i = 0; i < frames; i++)
+		Backtrace.append(QString("function%1() at qrc:/scripts/module%2.js:%3").arg(i).arg(i % 5).arg(i * 7 + 3));
+	QVariantMap Result;
+	Result["result"] = Backtrace;
+	Result["type"] = "QStringList";
+	QVariantMap Message;
+	Message["ID"] = 7;
+	Message["Result"] = Result;
+	return Message;
+}
+
+// the reply to ScriptObjectSnapshotCapture when a scope gets expanded
+static QVariant snapshotResult(int count)
+{
+	QVariantList Properties;
+	for (int i = 0; i < count; i++)
+		Properties.append(makeProperty(i));
+	QVariantMap Delta;
+	Delta["addedProperties"] = Properties;
+	Delta["changedProperties"] = QVariantList();
+	Delta["removedProperties"] = QStringList();
+	QVariantMap Result;
+	Result["result"] = Delta;
+	Result["type"] = "QScriptDebuggerValuePropertyList";
+	QVariantMap Message;
+	Message["ID"] = 8;
+	Message["Result"] = Result;
+	return Message;
+}
+
+// the queued events drained by a PullEvent with All set
+static QVariant eventsResult(int count)
+{
+	QVariantList Events;
+	for (int i = 0; i < count; i++) {
+		QVariantMap Attributes;
+		Attributes["message"] = QString("trace message number %1 from the script").arg(i);
+		QVariantMap Event;
+		Event["type"] = "Trace";
+		Event["attributes"] = Attributes;
+		Events.append(Event);
+	}
+	QVariantMap Message;
+	Message["Events"] = Events;
+	return Message;
+}
+
+// the codec does not keep the exact variant types, e.g. a QStringList comes back as a QVariantList of strings
+static bool sameValue(const QVariant& a, const QVariant& b)
+{
+	switch (a.userType())
+	{
+	case QMetaType::QVariantMap:
+	{
+		QVariantMap A = a.toMap();
+		QVariantMap B = b.toMap();
+		if (b.userType() != QMetaType::QVariantMap || A.size() != B.size())
+			return false;
+		for (QVariantMap::const_iterator I = A.constBegin(); I != A.constEnd(); ++I) {
+			if (!B.contains(I.key()) || !sameValue(I.value(), B[I.key()]))
+				return false;
+		}
+		return true;
+	}
+	case QMetaType::QStringList:
+	case QMetaType::QVariantList:
+	{
+		QVariantList A = a.toList();
+		QVariantList B = b.toList();
+		if (b.userType() != QMetaType::QVariantList || A.size() != B.size())
+			return false;
+		for (int i = 0; i < A.size(); i++) {
+			if (!sameValue(A[i], B[i]))
+				return false;
+		}
+		return true;
+	}
+	case QMetaType::QString:
+		return b.userType() == QMetaType::QString && a.toString() == b.toString();
+	case QMetaType::Bool:
+		return b.userType() == QMetaType::Bool && a.toBool() == b.toBool();
+	case QMetaType::ULongLong:
+		return b.toULongLong() == a.toULongLong();
+	default:
+		return a.toDouble() == b.toDouble();
+	}
+}
+
+static bool benchmark(const char* name, const QVariant& payload, int iterations)
+{
+	bool ok = false;
+	QByteArray cbor = CJSScriptDebuggerCodec::encode(payload);
+	if (!sameValue(payload, CJSScriptDebuggerCodec::decode(cbor, &ok)) || !ok) {
+		printf("%-24s round trip FAILED\n", name);
+		return false;
+	}
+	QByteArray json = QJsonDocument::fromVariant(payload).toJson(QJsonDocument::Compact);
+
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < iterations; i++)
+		cbor = CJSScriptDebuggerCodec::encode(payload);
+	qint64 cborEncode = timer.nsecsElapsed();
+	timer.restart();
+	for (int i = 0; i < iterations; i++)
+		CJSScriptDebuggerCodec::decode(cbor);
+	qint64 cborDecode = timer.nsecsElapsed();
+
+	timer.restart();
+	for (int i = 0; i < iterations; i++)
+		json = QJsonDocument::fromVariant(payload).toJson(QJsonDocument::Compact);
+	qint64 jsonEncode = timer.nsecsElapsed();
+	timer.restart();
+	for (int i = 0; i < iterations; i++)
+		QJsonDocument::fromJson(json).toVariant();
+	qint64 jsonDecode = timer.nsecsElapsed();
+
+	printf("%-24s %8d %8d %10.1f %10.1f %10.1f %10.1f\n", name, int(cbor.size()), int(json.size()),
+		cborEncode / 1000.0 / iterations, cborDecode / 1000.0 / iterations, jsonEncode / 1000.0 / iterations, jsonDecode / 1000.0 / iterations);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	int iterations = argc > 1 ? atoi(argv[1]) : 1000;
+
+	printf("%-24s %8s %8s %10s %10s %10s %10s\n", "payload", "cbor B", "json B", "cbor enc", "cbor dec", "json enc", "json dec");
+	printf("%-24s %8s %8s %10s %10s %10s %10s\n", "", "", "", "us", "us", "us", "us");
+
+	bool ok = true;
+	ok &= benchmark("pause event", pauseEvent(), iterations);
+	ok &= benchmark("backtrace 32 frames", backtraceResult(32), iterations);
+	ok &= benchmark("snapshot 20 properties", snapshotResult(20), iterations);
+	ok &= benchmark("snapshot 1000 properties", snapshotResult(1000), qMax(1, iterations / 50));
+	ok &= benchmark("100 trace events", eventsResult(100), qMax(1, iterations / 10));
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,495 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 NeoLoader Team
+** All rights reserved.
+** Contact: XanatosDavid@gmil.com
+**
+** This file is part of the NeoScriptTools module for NeoLoader
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation and
+** appearing in the file LICENSE.LGPL included in the packaging of this
+** file. Please review the following information to ensure the GNU Lesser
+** General Public License version 2.1 requirements will be met:
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+**
+**
+****************************************************************************/
+
+#include "JSScriptDebuggerCodec.h"
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+#include <qnumeric.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+// Names sent as table indexes, new entries must only ever be appended
+static const char* const g_Names[] = {
+	// message envelope
+	"Control", "Command", "ID", "Request", "Event", "Events", "Result", "Response", "Subscribed", "All",
+	"PullEvent", "Detach", "Subscribe",
+	// common attributes
+	"type", "attributes", "value", "result", "error", "message", "name", "id", "data", "flags",
+	"length", "ref", "from", "count", "contents",
+	"fileName", "scriptId", "lineNumber", "columnNumber", "baseLineNumber", "contextIndex",
+	"functionName", "functionType", "functionParameterNames",
+	"breakpointId", "breakpointData", "enabled", "singleShot", "ignoreCount", "hitCount", "condition", "conditionTime", "logMessage",
+	"scriptValue", "subordinateScriptValue", "valueAsString", "program", "isNestedEvaluate", "hasExceptionHandler",
+	"iteratorId", "snapshotId", "stepCount", "hasMore", "userAttribute",
+	"added", "removed", "addedProperties", "changedProperties", "removedProperties",
+	"records", "timeStamp", "engine", "async", "binary", "bytes", "elementType", "elementSize", "bigEndian",
+	// command types
+	"None", "Interrupt", "Continue", "StepInto", "StepOver", "StepOut", "RunToLocation", "RunToLocationByID", "ForceReturn", "Resume",
+	"SetBreakpoint", "DeleteBreakpoint", "DeleteAllBreakpoints", "GetBreakpoints", "GetBreakpointData", "SetBreakpointData",
+	"GetScripts", "GetScriptData", "ScriptsCheckpoint", "GetScriptsDelta", "ResolveScript",
+	"GetBacktrace", "GetContextCount", "GetContextInfo", "GetContextState", "GetContextID", "GetThisObject", "GetActivationObject",
+	"GetScopeChain", "ContextsCheckpoint", "GetPropertyExpressionValue", "GetCompletions",
+	"NewScriptObjectSnapshot", "ScriptObjectSnapshotCapture", "DeleteScriptObjectSnapshot",
+	"NewScriptValueIterator", "GetPropertiesByIterator", "DeleteScriptValueIterator",
+	"Evaluate", "SetScriptValueProperty", "ScriptValueToString", "ClearExceptions", "GetStringRange", "UserCommand",
+	// event types
+	"Interrupted", "SteppingFinished", "LocationReached", "Breakpoint", "Exception", "Trace", "InlineEvalFinished",
+	"DebuggerInvocationRequest", "ForcedReturn", "UserEvent", "Log",
+	// value types
+	"NoValue", "UndefinedValue", "NullValue", "BooleanValue", "StringValue", "NumberValue", "ObjectValue",
+	// response types and errors
+	"QScriptBreakpointData", "QScriptBreakpointMap", "QScriptScriptData", "QScriptScriptMap",
+	"QScriptDebuggerValue", "QScriptDebuggerValueList", "QScriptDebuggerValuePropertyList", "QString", "int",
+	"InvalidContextIndex", "InvalidArgumentIndex", "InvalidScriptID", "InvalidBreakpointID", "UserError", "DetachedError"
+};
+
+// Names added in wire version 2, batched commands
+static const char* const g_NamesV2[] = {
+	"Batch", "Results"
+};
+
+struct SNameTable
+{
+	SNameTable()
+	{
+		for (int i = 0; i < int(sizeof(g_Names) / sizeof(g_Names[0])); i++)
+			append(g_Names[i]);
+		V1Count = Names.size();
+		for (int i = 0; i < int(sizeof(g_NamesV2) / sizeof(g_NamesV2[0])); i++)
+			append(g_NamesV2[i]);
+	}
+
+	void append(const char* name)
+	{
+		Names.append(QString::fromLatin1(name));
+		Indexes.insert(Names.last(), Names.size() - 1);
+	}
+
+	int versionOf(int index) const { return index < V1Count ? 1 : 2; } // the wire version which added the name
+
+	QVector<QString>	Names;
+	QHash<QString, int>	Indexes;
+	int					V1Count;
+};
+
+static const SNameTable& nameTable()
+{
+	static const SNameTable Table;
+	return Table;
+}
+
+enum ECborMajor
+{
+	eUnsigned = 0,
+	eNegative = 1,
+	eBytes = 2,
+	eText = 3,
+	eArray = 4,
+	eMap = 5,
+	eTag = 6,
+	eSimple = 7
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Encoder
+
+static void writeHead(QByteArray& out, int major, quint64 value)
+{
+	char head = char(major << 5);
+	if (value < 24)
+		out.append(char(head | value));
+	else if (value <= 0xFF) {
+		out.append(char(head | 24));
+		out.append(char(value));
+	}
+	else if (value <= 0xFFFF) {
+		out.append(char(head | 25));
+		for (int i = 8; i >= 0; i -= 8)
+			out.append(char(value >> i));
+	}
+	else if (value <= 0xFFFFFFFF) {
+		out.append(char(head | 26));
+		for (int i = 24; i >= 0; i -= 8)
+			out.append(char(value >> i));
+	}
+	else {
+		out.append(char(head | 27));
+		for (int i = 56; i >= 0; i -= 8)
+			out.append(char(value >> i));
+	}
+}
+
+static void writeInteger(QByteArray& out, qint64 value)
+{
+	if (value >= 0)
+		writeHead(out, eUnsigned, quint64(value));
+	else
+		writeHead(out, eNegative, quint64(-1 - value));
+}
+
+static void writeDouble(QByteArray& out, double value)
+{
+	float single = float(value);
+	if (double(single) == value) { // lossless, this covers most line numbers and ids which come in as doubles from JSON like sources
+		quint32 bits;
+		memcpy(&bits, &single, sizeof(bits));
+		out.append(char(0xFA));
+		for (int i = 24; i >= 0; i -= 8)
+			out.append(char(bits >> i));
+	}
+	else {
+		quint64 bits;
+		memcpy(&bits, &value, sizeof(bits));
+		out.append(char(0xFB));
+		for (int i = 56; i >= 0; i -= 8)
+			out.append(char(bits >> i));
+	}
+}
+
+static void writeText(QByteArray& out, const QString& str)
+{
+	QByteArray utf8 = str.toUtf8();
+	writeHead(out, eText, utf8.size());
+	out.append(utf8);
+}
+
+static void writeKey(QByteArray& out, const QString& key, int& version)
+{
+	QHash<QString, int>::const_iterator I = nameTable().Indexes.find(key);
+	if (I != nameTable().Indexes.end()) {
+		writeHead(out, eUnsigned, I.value());
+		version = qMax(version, nameTable().versionOf(I.value()));
+	}
+	else
+		writeText(out, key);
+}
+
+static void writeValue(QByteArray& out, const QVariant& var, int& version)
+{
+	switch (var.userType())
+	{
+	case QMetaType::Bool:
+		out.append(char(var.toBool() ? 0xF5 : 0xF4));
+		break;
+	case QMetaType::Int:
+	case QMetaType::Long:
+	case QMetaType::LongLong:
+	case QMetaType::Short:
+	case QMetaType::Char:
+	case QMetaType::SChar:
+		writeInteger(out, var.toLongLong());
+		break;
+	case QMetaType::UInt:
+	case QMetaType::ULong:
+	case QMetaType::ULongLong:
+	case QMetaType::UShort:
+	case QMetaType::UChar:
+		writeHead(out, eUnsigned, var.toULongLong());
+		break;
+	case QMetaType::Double:
+	case QMetaType::Float:
+		writeDouble(out, var.toDouble());
+		break;
+	case QMetaType::QString:
+	{
+		QString str = var.toString();
+		QHash<QString, int>::const_iterator I = nameTable().Indexes.find(str);
+		if (I != nameTable().Indexes.end()) {
+			writeHead(out, eTag, CJSScriptDebuggerCodec::NameTag);
+			writeHead(out, eUnsigned, I.value());
+			version = qMax(version, nameTable().versionOf(I.value()));
+		}
+		else
+			writeText(out, str);
+		break;
+	}
+	case QMetaType::QByteArray:
+	{
+		QByteArray bytes = var.toByteArray();
+		writeHead(out, eBytes, bytes.size());
+		out.append(bytes);
+		break;
+	}
+	case QMetaType::QStringList:
+	{
+		QStringList list = var.toStringList();
+		writeHead(out, eArray, list.size());
+		foreach(const QString& value, list)
+			writeText(out, value);
+		break;
+	}
+	case QMetaType::QVariantList:
+	{
+		QVariantList list = var.toList();
+		writeHead(out, eArray, list.size());
+		foreach(const QVariant& value, list)
+			writeValue(out, value, version);
+		break;
+	}
+	case QMetaType::QVariantMap:
+	{
+		QVariantMap map = var.toMap();
+		writeHead(out, eMap, map.size());
+		for (QVariantMap::const_iterator I = map.constBegin(); I != map.constEnd(); ++I) {
+			writeKey(out, I.key(), version);
+			writeValue(out, I.value(), version);
+		}
+		break;
+	}
+	case QMetaType::QVariantHash:
+	{
+		QVariantHash hash = var.toHash();
+		writeHead(out, eMap, hash.size());
+		for (QVariantHash::const_iterator I = hash.constBegin(); I != hash.constEnd(); ++I) {
+			writeKey(out, I.key(), version);
+			writeValue(out, I.value(), version);
+		}
+		break;
+	}
+	default:
+		if (var.isValid() && var.canConvert<QString>()) // same as the JSON path, anything else is sent as string if possible
+			writeText(out, var.toString());
+		else
+			out.append(char(0xF7)); // undefined
+	}
+}
+
+QByteArray CJSScriptDebuggerCodec::encode(const QVariant& var)
+{
+	QByteArray out;
+	out.reserve(256);
+	// a message is sent with the oldest wire version which knows all names it uses,
+	// so an older decoder still understands everything but the newer features
+	int version = 1;
+	writeHead(out, eArray, 2);
+	int versionPos = out.size();
+	writeHead(out, eUnsigned, WireVersion);
+	writeValue(out, var, version);
+	out[versionPos] = char((eUnsigned << 5) | version); // versions below 24 take a single byte
+	return out;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Decoder
+
+struct SCborReader
+{
+	enum { MaxDepth = 256 };
+
+	SCborReader(const QByteArray& data)
+		: Pos((const uchar*)data.constData()), End(Pos + data.size()), Error(false) {}
+
+	bool readHead(int& major, quint64& value)
+	{
+		if (Pos >= End)
+			return fail();
+		uchar head = *Pos++;
+		major = head >> 5;
+		int info = head & 0x1F;
+		if (info < 24) {
+			value = info;
+			return true;
+		}
+		if (info > 27) // indefinite lengths and reserved values are never written by encode
+			return fail();
+		int size = 1 << (info - 24);
+		if (End - Pos < size)
+			return fail();
+		value = 0;
+		for (int i = 0; i < size; i++)
+			value = (value << 8) | *Pos++;
+		return true;
+	}
+
+	QVariant readValue(int depth)
+	{
+		const uchar* head = Pos;
+		int major;
+		quint64 value;
+		if (depth > MaxDepth || !readHead(major, value))
+			return failed();
+
+		switch (major)
+		{
+		case eUnsigned:
+			if (value <= quint64(INT_MAX))
+				return int(value);
+			if (value <= quint64(LLONG_MAX))
+				return qint64(value);
+			return quint64(value);
+		case eNegative:
+			if (value <= quint64(INT_MAX))
+				return int(-1 - qint64(value));
+			if (value <= quint64(LLONG_MAX))
+				return -1 - qint64(value);
+			return failed();
+		case eBytes:
+		case eText:
+		{
+			if (value > quint64(End - Pos))
+				return failed();
+			const char* str = (const char*)Pos;
+			Pos += value;
+			if (major == eBytes)
+				return QByteArray(str, int(value));
+			return QString::fromUtf8(str, int(value));
+		}
+		case eArray:
+		{
+			if (value > quint64(End - Pos)) // every item takes at least one byte
+				return failed();
+			QVariantList list;
+			list.reserve(int(value));
+			for (quint64 i = 0; i < value && !Error; i++)
+				list.append(readValue(depth + 1));
+			return list;
+		}
+		case eMap:
+		{
+			if (value > quint64(End - Pos) / 2)
+				return failed();
+			QVariantMap map;
+			for (quint64 i = 0; i < value && !Error; i++) {
+				QString key = readKey();
+				map.insert(key, readValue(depth + 1));
+			}
+			return map;
+		}
+		case eTag:
+		{
+			if (value != CJSScriptDebuggerCodec::NameTag)
+				return failed();
+			return readName();
+		}
+		default: // eSimple
+		{
+			switch (*head)
+			{
+			case 0xF4: return false;
+			case 0xF5: return true;
+			case 0xF6: // null
+			case 0xF7: return QVariant(); // undefined
+			case 0xF9: return halfToDouble(quint16(value));
+			case 0xFA:
+			{
+				quint32 bits = quint32(value);
+				float single;
+				memcpy(&single, &bits, sizeof(single));
+				return double(single);
+			}
+			case 0xFB:
+			{
+				double result;
+				memcpy(&result, &value, sizeof(result));
+				return result;
+			}
+			}
+			return failed();
+		}
+		}
+	}
+
+	QString readKey()
+	{
+		if (Pos < End && (*Pos >> 5) == eUnsigned)
+			return readName();
+		QVariant key = readValue(MaxDepth);
+		if (key.userType() != QMetaType::QString)
+			fail();
+		return key.toString();
+	}
+
+	QString readName()
+	{
+		int major;
+		quint64 value;
+		if (!readHead(major, value) || major != eUnsigned || value >= quint64(nameTable().Names.size())) {
+			fail();
+			return QString();
+		}
+		return nameTable().Names.at(int(value));
+	}
+
+	static double halfToDouble(quint16 half)
+	{
+		int exp = (half >> 10) & 0x1F;
+		int mant = half & 0x3FF;
+		double val;
+		if (exp == 0)
+			val = ldexp(double(mant), -24);
+		else if (exp != 31)
+			val = ldexp(double(mant + 1024), exp - 25);
+		else
+			val = mant == 0 ? qInf() : qQNaN();
+		return (half & 0x8000) ? -val : val;
+	}
+
+	bool fail()
+	{
+		Error = true;
+		Pos = End;
+		return false;
+	}
+
+	QVariant failed()
+	{
+		fail();
+		return QVariant();
+	}
+
+	const uchar*	Pos;
+	const uchar*	End;
+	bool			Error;
+};
+
+QVariant CJSScriptDebuggerCodec::decode(const QByteArray& data, bool* ok)
+{
+	SCborReader Reader(data);
+
+	int major;
+	quint64 value;
+	QVariant var;
+	if (Reader.readHead(major, value) && major == eArray && value == 2) {
+		QVariant version = Reader.readValue(0);
+		if (!Reader.Error && version.toLongLong() >= 1 && version.toLongLong() <= WireVersion)
+			var = Reader.readValue(0);
+		else
+			Reader.fail();
+	}
+	else
+		Reader.fail();
+
+	if (Reader.Pos != Reader.End) // trailing garbage
+		Reader.fail();
+	if (ok)
+		*ok = !Reader.Error;
+	return Reader.Error ? QVariant() : var;
+}
@@ -0,0 +1,59 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 NeoLoader Team
+** All rights reserved.
+** Contact: XanatosDavid@gmil.com
+**
+** This file is part of the NeoScriptTools module for NeoLoader
+**
+** GNU Lesser General Public License Usage
+** This file may be used under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation and
+** appearing in the file LICENSE.LGPL included in the packaging of this
+** file. Please review the following information to ensure the GNU Lesser
+** General Public License version 2.1 requirements will be met:
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+**
+**
+****************************************************************************/
+
+#ifndef JSSCRIPTDEBUGGERCODEC_H
+#define JSSCRIPTDEBUGGERCODEC_H
+
+#include <QVariant>
+#include <QByteArray>
+
+#include "../neoscripttools_global.h"
+
+// Binary wire format for the QVariant messages exchanged between CJSScriptDebuggerFrontend and the backends,
+// a more compact and faster alternative to JSON when frontend and backend are connected through a socket or pipe.
+//
+// A message is encoded as CBOR (RFC 8949): an array of the wire version and the value.
+// Map keys which are well known protocol names are sent as integers indexing a fixed name table,
+// well known string values (command, event and value types) are sent as such an index marked with NameTag.
+// The name table is append only, a decoder understands all messages of its own or an older wire version,
+// each message is sent with the oldest version which knows all names it uses, only batches need version 2.
+
+class NEOSCRIPTTOOLS_EXPORT CJSScriptDebuggerCodec
+{
+public:
+	enum {
+		WireVersion = 2, // the newest version, 2 added the batch names
+		NameTag = 0x4E54 // private CBOR tag for name table indexes
+	};
+
+	static QByteArray encode(const QVariant& var);
+	static QVariant decode(const QByteArray& data, bool* ok = 0);
+};
+
+#endif
@@ -36,19 +36,27 @@ class CJSScriptDebuggerFrontendPrivate: public QObjectPrivate
 public:
 	
 	int eventTimerId;
+	bool subscribeSent = false;
+
+	bool batchCommands = false;	// the backend confirmed it takes several commands in one request
+	int batchTimerId = 0;
+	QVariantList pendingCommands;
 };
 
 CJSScriptDebuggerFrontend::CJSScriptDebuggerFrontend(QObject *parent)
 	: QObject(*new CJSScriptDebuggerFrontendPrivate, parent)
 {
 	Q_D(CJSScriptDebuggerFrontend);
-	d->eventTimerId = startTimer(75); // pull events 
+	d->eventTimerId = startTimer(75); // pull events, until the backend confirms it pushes them
 }
 
 CJSScriptDebuggerFrontend::~CJSScriptDebuggerFrontend()
 {
 	Q_D(CJSScriptDebuggerFrontend);
-	killTimer(d->eventTimerId);
+	if (d->eventTimerId)
+		killTimer(d->eventTimerId);
+	if (d->batchTimerId)
+		killTimer(d->batchTimerId);
 }
 
 void CJSScriptDebuggerFrontend::processResponse(const QVariant& var)
@@ -58,22 +66,52 @@ void CJSScriptDebuggerFrontend::processResponse(const QVariant& var)
 	QVariantMap in = var.toMap();
 	if (in.contains("Event")) 
 		notifyEvent(in["Event"].toMap());
+	else if (in.contains("Events")) {
+		foreach(const QVariant& event, in["Events"].toList())
+			notifyEvent(event.toMap());
+	}
 	else if (in.contains("Result")) 
 		notifyCommandFinished((int)in["ID"].toInt(), in["Result"].toMap());
+	else if (in.contains("Results")) { // reply to a batch, in the order the commands were sent
+		foreach(const QVariant& result, in["Results"].toList()) {
+			QVariantMap Result = result.toMap();
+			notifyCommandFinished((int)Result["ID"].toInt(), Result["Result"].toMap());
+		}
+	}
 	else if (in.contains("Response")) 
 		emit processCustom(in["Response"]);
+	else if (in.contains("Subscribed")) {
+		// the backend pushes its events from now on, polling stays only for backends or transports which can not
+		if (d->eventTimerId) {
+			killTimer(d->eventTimerId);
+			d->eventTimerId = 0;
+		}
+		d->batchCommands = in["Batch"].toBool();
+	}
 }
 
 void CJSScriptDebuggerFrontend::timerEvent(QTimerEvent *e)
 {
 	Q_D(CJSScriptDebuggerFrontend);
+	if (e->timerId() == d->batchTimerId) {
+		flushCommands();
+		return;
+	}
     if (e->timerId() != d->eventTimerId) {
         QObject::timerEvent(e);
 		return;
     }
+
+	if (!d->subscribeSent) { // ask once, on the first poll, when the frontend is connected
+		d->subscribeSent = true;
+		QVariantMap out;
+		out["Control"] = "Subscribe";
+		emit sendRequest(out);
+	}
 
 	QVariantMap out;
 	out["Control"] = "PullEvent";
+	out["All"] = true; // backends which know it reply with all pending events at once
     emit sendRequest(out);
 }
 
@@ -84,11 +122,42 @@ void CJSScriptDebuggerFrontend::processCommand(int id, const QVariantMap &comman
 	QVariantMap out;
 	out["ID"] = id;
 	out["Command"] = command;
+	if (d->batchCommands) {
+		// commands issued in the same event loop pass, e.g. by the jobs refreshing the views on a pause, go out in one request
+		d->pendingCommands.append(out);
+		if (!d->batchTimerId)
+			d->batchTimerId = startTimer(0);
+		return;
+	}
+    emit sendRequest(out);
+}
+
+void CJSScriptDebuggerFrontend::flushCommands()
+{
+	Q_D(CJSScriptDebuggerFrontend);
+
+	if (d->batchTimerId) {
+		killTimer(d->batchTimerId);
+		d->batchTimerId = 0;
+	}
+
+	if (d->pendingCommands.isEmpty())
+		return;
+	if (d->pendingCommands.size() == 1) {
+		emit sendRequest(d->pendingCommands.takeFirst());
+		return;
+	}
+
+	QVariantMap out;
+	out["Batch"] = d->pendingCommands;
+	d->pendingCommands.clear();
     emit sendRequest(out);
 }
 
 void CJSScriptDebuggerFrontend::detach()
 {
+	flushCommands();
+
 	QVariantMap out;
 	out["Control"] = "Detach";
     emit sendRequest(out);
@@ -96,6 +165,8 @@ void CJSScriptDebuggerFrontend::detach()
 
 void CJSScriptDebuggerFrontend::sendCustom(const QVariant& var)
 {
+	flushCommands(); // keep the order of commands and custom requests
+
 	QVariantMap out;
 	out["Request"] = var;
     emit sendRequest(out);
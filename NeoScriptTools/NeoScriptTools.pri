@@ -108,7 +108,8 @@ HEADERS += ./neoscripttools_global.h \
     ./JSDebugging/JSScriptDebugger.h \
     ./JSDebugging/JSScriptDebuggerFrontendInterface.h \
     ./JSDebugging/JSScriptDebuggerBackend.h \
-    ./JSDebugging/JSScriptDebuggerFrontend.h
+    ./JSDebugging/JSScriptDebuggerFrontend.h \
+    ./JSDebugging/JSScriptDebuggerCodec.h
 SOURCES += ./debugging/qscriptbreakpointdata.cpp \
     ./debugging/qscriptbreakpointsmodel.cpp \
     ./debugging/qscriptbreakpointswidget.cpp \
@@ -171,5 +172,6 @@ SOURCES += ./debugging/qscriptbreakpointdata.cpp \
     ./JSDebugging/JSScriptDebugger.cpp \
     ./JSDebugging/JSScriptDebuggerBackend.cpp \
     ./JSDebugging/JSScriptDebuggerFrontend.cpp \
-    ./JSDebugging/JSScriptDebuggerFrontendInterface.cpp
+    ./JSDebugging/JSScriptDebuggerFrontendInterface.cpp \
+    ./JSDebugging/JSScriptDebuggerCodec.cpp
 RESOURCES += debugging/scripttools_debugging.qrc
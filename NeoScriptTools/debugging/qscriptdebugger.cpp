@@ -85,6 +85,7 @@
 #include <QtCore/qfileinfo.h>
 #include <QtCore/qstringlist.h>
 #include <QtCore/qdebug.h>
+#include <QtCore/qdatetime.h>
 
 #if QT_VERSION < 0x050000
 #include <QtGui/qaction.h>
@@ -396,6 +397,27 @@ bool QScriptDebuggerPrivate::debuggerEvent(const QScriptDebuggerEvent &event)
             debugOutputWidget->message(QtDebugMsg, event.message());
         return true; // trace doesn't stall execution
 
+	//> NeoScriptTools
+    case QScriptDebuggerEvent::Log: {
+        if (!debugOutputWidget && widgetFactory)
+            q->setDebugOutputWidget(widgetFactory->createDebugOutputWidget());
+        if (debugOutputWidget) {
+            QVariantList records = event.attribute(QScriptDebuggerEvent::Records).toList();
+            foreach (const QVariant &var, records) {
+                QVariantMap record = var.toMap();
+                debugOutputWidget->message(QtDebugMsg, QString::fromLatin1("%0 %1, line %2: %3")
+                    .arg(QDateTime::fromMSecsSinceEpoch(record.value(QLatin1String("timeStamp")).toLongLong()).toString(QLatin1String("hh:mm:ss.zzz")))
+                    .arg(record.value(QLatin1String("fileName")).toString())
+                    .arg(record.value(QLatin1String("lineNumber")).toInt())
+                    .arg(record.value(QLatin1String("message")).toString()));
+            }
+            QString msg = event.message();
+            if (!msg.isEmpty())
+                debugOutputWidget->message(QtWarningMsg, msg);
+        }
+    }   return false; // logpoints never pause the engine, so there is nothing to resume
+	//< NeoScriptTools
+
     case QScriptDebuggerEvent::SteppingFinished: {
         if (!consoleWidget && widgetFactory)
             q->setConsoleWidget(widgetFactory->createConsoleWidget());
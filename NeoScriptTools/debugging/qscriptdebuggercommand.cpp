@@ -595,12 +595,14 @@ QScriptDebuggerCommand QScriptDebuggerCommand::newScriptObjectSnapshotCommand()
     return cmd;
 }
 
-QScriptDebuggerCommand QScriptDebuggerCommand::scriptObjectSnapshotCaptureCommand(int id, const QScriptDebuggerValue &object)
+QScriptDebuggerCommand QScriptDebuggerCommand::scriptObjectSnapshotCaptureCommand(int id, const QScriptDebuggerValue &object, int count)
 {
     Q_ASSERT(object.type() == QScriptDebuggerValue::ObjectValue);
     QScriptDebuggerCommand cmd(ScriptObjectSnapshotCapture);
     cmd.setSnapshotId(id);
     cmd.setScriptValue(object);
+    if (count >= 0) // NeoScriptTools: only capture the first count properties
+        cmd.setAttribute(Count, count);
     return cmd;
 }
 
@@ -621,9 +623,9 @@ QScriptDebuggerCommand QScriptDebuggerCommand::newScriptValueIteratorCommand(con
 
 QScriptDebuggerCommand QScriptDebuggerCommand::getPropertiesByIteratorCommand(int id, int count)
 {
-    Q_UNUSED(count);
     QScriptDebuggerCommand cmd(GetPropertiesByIterator);
     cmd.setIteratorId(id);
+    cmd.setAttribute(Count, count); // NeoScriptTools
     return cmd;
 }
 
@@ -652,6 +654,18 @@ QScriptDebuggerCommand QScriptDebuggerCommand::scriptValueToStringCommand(const
     return cmd;
 }
 
+//> NeoScriptTools
+QScriptDebuggerCommand QScriptDebuggerCommand::getStringRangeCommand(const QScriptDebuggerValue &value, int from, int count)
+{
+    Q_ASSERT(value.type() == QScriptDebuggerValue::StringValue);
+    QScriptDebuggerCommand cmd(GetStringRange);
+    cmd.setScriptValue(value);
+    cmd.setAttribute(From, from);
+    cmd.setAttribute(Count, count);
+    return cmd;
+}
+//< NeoScriptTools
+
 QScriptDebuggerCommand QScriptDebuggerCommand::setScriptValuePropertyCommand(
     const QScriptDebuggerValue &object, const QString &name,
     const QScriptDebuggerValue &value)
@@ -726,6 +740,7 @@ void QScriptDebuggerCommand::fromVariant(const QVariant& var)
 
 	else if(typeStr == "SetScriptValueProperty") type = SetScriptValueProperty;
 	else if(typeStr == "ScriptValueToString") type = ScriptValueToString;
+	else if(typeStr == "GetStringRange") type = GetStringRange;
 
 	else if(typeStr == "ClearExceptions") type = ClearExceptions;
 
@@ -749,6 +764,8 @@ void QScriptDebuggerCommand::fromVariant(const QVariant& var)
 		else if(keyStr == "name") key = Name;
 		else if(keyStr == "subordinateScriptValue") key = SubordinateScriptValue;
 		else if(keyStr == "snapshotId") key = SnapshotID;
+		else if(keyStr == "count") key = Count;
+		else if(keyStr == "from") key = From;
 		else if(keyStr == "userAttribute") key = UserAttribute;
         attribs[key] =  attribsMap[keyStr];
     }
@@ -811,6 +828,7 @@ QVariant QScriptDebuggerCommand::toVariant() const
 
 	case SetScriptValueProperty: typeStr = "SetScriptValueProperty"; break;
 	case ScriptValueToString: typeStr = "ScriptValueToString"; break;
+	case GetStringRange: typeStr = "GetStringRange"; break;
 
 	case ClearExceptions: typeStr = "ClearExceptions"; break;
 
@@ -837,6 +855,8 @@ QVariant QScriptDebuggerCommand::toVariant() const
 		case Name: keyStr = "name"; break;
 		case SubordinateScriptValue: keyStr = "subordinateScriptValue"; break;
 		case SnapshotID: keyStr = "snapshotId"; break;
+		case Count: keyStr = "count"; break;
+		case From: keyStr = "from"; break;
         case UserAttribute: keyStr = "userAttribute"; break;
 		default: Q_ASSERT(0);
 		}
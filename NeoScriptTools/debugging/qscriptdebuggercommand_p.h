@@ -126,6 +126,7 @@ public:
 
         SetScriptValueProperty,
         ScriptValueToString,
+        GetStringRange, // NeoScriptTools
 
         ClearExceptions,
 
@@ -147,6 +148,8 @@ public:
         Name,
         SubordinateScriptValue,
         SnapshotID,
+        Count, // NeoScriptTools
+        From, // NeoScriptTools
         UserAttribute = 1000,
         MaxUserAttribute = 32767
     };
@@ -241,7 +244,7 @@ public:
     static QScriptDebuggerCommand getCompletions(int contextIndex, const QStringList &path);
 
     static QScriptDebuggerCommand newScriptObjectSnapshotCommand();
-    static QScriptDebuggerCommand scriptObjectSnapshotCaptureCommand(int id, const QScriptDebuggerValue &object);
+    static QScriptDebuggerCommand scriptObjectSnapshotCaptureCommand(int id, const QScriptDebuggerValue &object, int count = -1);
     static QScriptDebuggerCommand deleteScriptObjectSnapshotCommand(int id);
 
     static QScriptDebuggerCommand newScriptValueIteratorCommand(const QScriptDebuggerValue &object);
@@ -256,6 +259,7 @@ public:
                                                                 const QString &name,
                                                                 const QScriptDebuggerValue &value);
     static QScriptDebuggerCommand scriptValueToStringCommand(const QScriptDebuggerValue &value);
+    static QScriptDebuggerCommand getStringRangeCommand(const QScriptDebuggerValue &value, int from, int count = -1); // NeoScriptTools
 
     static QScriptDebuggerCommand clearExceptionsCommand();
 
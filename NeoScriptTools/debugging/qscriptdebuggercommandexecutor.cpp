@@ -522,11 +522,11 @@ QScriptDebuggerResponse QScriptDebuggerCommandExecutor::execute(
 
     case QScriptDebuggerCommand::GetPropertiesByIterator: {
         int id = command.iteratorId();
-        int count = 1000;
+        int count = command.attribute(QScriptDebuggerCommand::Count, 1000).toInt(); // NeoScriptTools
         QScriptValueIterator *it = backend->scriptValueIterator(id);
         Q_ASSERT(it != 0);
         QScriptDebuggerValuePropertyList props;
-        for (int i = 0; (i < count) && it->hasNext(); ++i) {
+        for (int i = 0; ((count < 0) || (i < count)) && it->hasNext(); ++i) {
             it->next();
             QString name = it->name();
             QScriptValue value = it->value();
@@ -560,6 +560,13 @@ QScriptDebuggerResponse QScriptDebuggerCommandExecutor::execute(
         response.setResult(realValue.toString());
     }   break;
 
+    case QScriptDebuggerCommand::GetStringRange: { // NeoScriptTools: strings are never truncated here
+        QScriptDebuggerValue value = command.scriptValue();
+        int from = command.attribute(QScriptDebuggerCommand::From).toInt();
+        int count = command.attribute(QScriptDebuggerCommand::Count, -1).toInt();
+        response.setResult(value.stringValue().mid(from, count));
+    }   break;
+
     case QScriptDebuggerCommand::SetScriptValueProperty: {
         QScriptDebuggerValue object = command.scriptValue();
         QScriptEngine *engine = backend->engine();
@@ -290,6 +290,11 @@ int QScriptDebuggerCommandSchedulerFrontend::scheduleScriptValueToString(const Q
     return scheduleCommand(QScriptDebuggerCommand::scriptValueToStringCommand(value));
 }
 
+int QScriptDebuggerCommandSchedulerFrontend::scheduleGetStringRange(const QScriptDebuggerValue &value, int from, int count)
+{
+    return scheduleCommand(QScriptDebuggerCommand::getStringRangeCommand(value, from, count));
+}
+
 int QScriptDebuggerCommandSchedulerFrontend::scheduleSetScriptValueProperty(const QScriptDebuggerValue &object,
                                                             const QString &name,
                                                             const QScriptDebuggerValue &value)
@@ -307,9 +312,9 @@ int QScriptDebuggerCommandSchedulerFrontend::scheduleNewScriptObjectSnapshot()
     return scheduleCommand(QScriptDebuggerCommand::newScriptObjectSnapshotCommand());
 }
 
-int QScriptDebuggerCommandSchedulerFrontend::scheduleScriptObjectSnapshotCapture(int id, const QScriptDebuggerValue &object)
+int QScriptDebuggerCommandSchedulerFrontend::scheduleScriptObjectSnapshotCapture(int id, const QScriptDebuggerValue &object, int count)
 {
-    return scheduleCommand(QScriptDebuggerCommand::scriptObjectSnapshotCaptureCommand(id, object));
+    return scheduleCommand(QScriptDebuggerCommand::scriptObjectSnapshotCaptureCommand(id, object, count));
 }
 
 int QScriptDebuggerCommandSchedulerFrontend::scheduleDeleteScriptObjectSnapshot(int id)
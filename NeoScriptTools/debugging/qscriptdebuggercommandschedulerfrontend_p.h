@@ -124,6 +124,7 @@ public:
                           int lineNumber = 1);
 
      int scheduleScriptValueToString(const QScriptDebuggerValue &value);
+     int scheduleGetStringRange(const QScriptDebuggerValue &value, int from, int count = -1); // NeoScriptTools
      int scheduleSetScriptValueProperty(const QScriptDebuggerValue &object,
                                         const QString &name,
                                         const QScriptDebuggerValue &value);
@@ -131,7 +132,7 @@ public:
      int scheduleClearExceptions();
 
      int scheduleNewScriptObjectSnapshot();
-     int scheduleScriptObjectSnapshotCapture(int id, const QScriptDebuggerValue &object);
+     int scheduleScriptObjectSnapshotCapture(int id, const QScriptDebuggerValue &object, int count = -1);
      int scheduleDeleteScriptObjectSnapshot(int id);
 
 private:
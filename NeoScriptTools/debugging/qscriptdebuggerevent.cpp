@@ -289,6 +289,7 @@ void QScriptDebuggerEvent::fromVariant(const QVariant& var)
 	else if(typeStr == "InlineEvalFinished") type = InlineEvalFinished;
 	else if(typeStr == "DebuggerInvocationRequest") type = DebuggerInvocationRequest;
 	else if(typeStr == "ForcedReturn") type = ForcedReturn;
+	else if(typeStr == "Log") type = Log;
 	else if(typeStr == "UserEvent") type = UserEvent;
 	else type = None;
     d->type = type;
@@ -306,6 +307,7 @@ void QScriptDebuggerEvent::fromVariant(const QVariant& var)
 		else if(keyStr == "message") key = Message;
 		else if(keyStr == "isNestedEvaluate") key = IsNestedEvaluate;
 		else if(keyStr == "hasExceptionHandler") key = HasExceptionHandler;
+		else if(keyStr == "records") key = Records;
 		else if(keyStr == "userAttribute") key = UserAttribute;
 		attribs[key] = attribsMap[keyStr];
     }
@@ -329,6 +331,7 @@ QVariant QScriptDebuggerEvent::toVariant() const
     case InlineEvalFinished: typeStr = "InlineEvalFinished"; break;
     case DebuggerInvocationRequest: typeStr = "DebuggerInvocationRequest"; break;
     case ForcedReturn: typeStr = "ForcedReturn"; break;
+    case Log: typeStr = "Log"; break;
     case UserEvent: typeStr = "UserEvent"; break;
 	default: Q_ASSERT(0);
 	}
@@ -348,6 +351,7 @@ QVariant QScriptDebuggerEvent::toVariant() const
         case Message: keyStr = "message"; break;
         case IsNestedEvaluate: keyStr = "isNestedEvaluate"; break;
         case HasExceptionHandler: keyStr = "hasExceptionHandler"; break;
+        case Records: keyStr = "records"; break;
         case UserAttribute: keyStr = "userAttribute"; break;
 		default: Q_ASSERT(0);
 		}
@@ -87,6 +87,7 @@ public:
         InlineEvalFinished,
         DebuggerInvocationRequest,
         ForcedReturn,
+        Log, // NeoScriptTools
         UserEvent = 1000,
         MaxUserEvent = 32767
     };
@@ -101,6 +102,7 @@ public:
         Message,
         IsNestedEvaluate,
         HasExceptionHandler,
+        Records, // NeoScriptTools
         UserAttribute = 1000,
         MaxUserAttribute = 32767
     };
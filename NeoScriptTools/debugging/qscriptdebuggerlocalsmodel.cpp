@@ -55,6 +55,7 @@
 #include <QtCore/qdebug.h>
 #include <QtCore/qcoreapplication.h>
 #include <QtCore/qpointer.h>
+#include <QtCore/qhash.h>
 #include <QtGui/qbrush.h>
 #include <QtGui/qfont.h>
 
@@ -70,14 +71,19 @@ struct QScriptDebuggerLocalsModelNode
         Populated
     };
 
+    enum { PageSize = 100 }; // NeoScriptTools: properties fetched at once
+    enum { TextPageSize = 10000 }; // NeoScriptTools: characters of a truncated string fetched at once
+
     QScriptDebuggerLocalsModelNode()
-        : parent(0), populationState(NotPopulated), snapshotId(-1), changed(false) {}
+        : parent(0), populationState(NotPopulated), snapshotId(-1), changed(false),
+          fetchLimit(PageSize), hasMore(false) {}
 
     QScriptDebuggerLocalsModelNode(
         const QScriptDebuggerValueProperty &prop,
         QScriptDebuggerLocalsModelNode *par)
         : property(prop), parent(par),
-          populationState(NotPopulated), snapshotId(-1), changed(false)
+          populationState(NotPopulated), snapshotId(-1), changed(false),
+          fetchLimit(PageSize), hasMore(false)
     {
         parent->children.append(this);
     }
@@ -100,6 +106,10 @@ struct QScriptDebuggerLocalsModelNode
     PopulationState populationState;
     int snapshotId;
     bool changed;
+    //> NeoScriptTools
+    int fetchLimit; // number of properties the snapshot captures
+    bool hasMore; // the object has properties beyond the limit
+    //< NeoScriptTools
 };
 
 class QScriptDebuggerLocalsModelPrivate
@@ -127,6 +137,8 @@ public:
     void syncTopLevelNodes();
     void removeTopLevelNodes();
     void emitScopeObjectAvailable(const QModelIndex &index);
+    void reallyFetchText(const QModelIndex &index, const QScriptDebuggerValue &value,
+                         const QString &text); // NeoScriptTools
 
     void emitDataChanged(const QModelIndex &tl, const QModelIndex &br);
     void removeChild(const QModelIndex &parentIndex,
@@ -207,6 +219,7 @@ void QScriptDebuggerLocalsModelPrivate::depopulate(QScriptDebuggerLocalsModelNod
     node->children.clear();
     node->snapshotId = -1;
     node->populationState = QScriptDebuggerLocalsModelNode::NotPopulated;
+    node->hasMore = false;
     if (hasChildren)
         q->endRemoveRows();
     deleteObjectSnapshots(snapshotIds);
@@ -392,7 +405,7 @@ public:
             Q_ASSERT(node->populationState == QScriptDebuggerLocalsModelNode::Populating);
             node->snapshotId = response.resultAsInt();
             QScriptDebuggerCommandSchedulerFrontend frontend(commandScheduler(), this);
-            frontend.scheduleScriptObjectSnapshotCapture(node->snapshotId, node->property.value());
+            frontend.scheduleScriptObjectSnapshotCapture(node->snapshotId, node->property.value(), node->fetchLimit);
             ++m_state;
         }   break;
         case 1: {
@@ -403,6 +416,7 @@ public:
             Q_ASSERT(delta.removedProperties.isEmpty());
             Q_ASSERT(delta.changedProperties.isEmpty());
             QScriptDebuggerValuePropertyList props = delta.addedProperties;
+            model()->nodeFromIndex(m_index)->hasMore = delta.hasMore;
             model()->reallyPopulateIndex(m_index, props);
             finish();
           } break;
@@ -677,7 +691,7 @@ public:
         }
         QScriptDebuggerCommandSchedulerFrontend frontend(commandScheduler(), this);
         QScriptDebuggerLocalsModelNode *node = model()->nodeFromIndex(m_index);
-        frontend.scheduleScriptObjectSnapshotCapture(node->snapshotId, node->property.value());
+        frontend.scheduleScriptObjectSnapshotCapture(node->snapshotId, node->property.value(), node->fetchLimit);
     }
 
     void handleResponse(const QScriptDebuggerResponse &response,
@@ -687,6 +701,9 @@ public:
         //delta = qvariant_cast<QScriptDebuggerObjectSnapshotDelta>(response.result());
         delta.fromVariant(response.result().toMap());
 
+        if (m_index.isValid())
+            model()->nodeFromIndex(m_index)->hasMore = delta.hasMore;
+
         model()->reallySyncIndex(m_index, delta);
         finish();
     }
@@ -714,6 +731,25 @@ void QScriptDebuggerLocalsModelPrivate::reallySyncIndex(const QModelIndex &index
     if (!index.isValid())
         return;
     QScriptDebuggerLocalsModelNode *node = nodeFromIndex(index);
+    //> NeoScriptTools
+    if (delta.isBinary) {
+        // a typed array is sent as its whole window of elements, so work out what changed here
+        QHash<QString, QScriptDebuggerLocalsModelNode*> children;
+        for (int i = 0; i < node->children.count(); ++i)
+            children.insert(node->children.at(i)->property.name(), node->children.at(i));
+        QScriptDebuggerObjectSnapshotDelta elementDelta;
+        for (int i = 0; i < delta.addedProperties.count(); ++i) {
+            const QScriptDebuggerValueProperty &prop = delta.addedProperties.at(i);
+            QScriptDebuggerLocalsModelNode *child = children.value(prop.name());
+            if (!child)
+                elementDelta.addedProperties.append(prop);
+            else if (child->property.value() != prop.value())
+                elementDelta.changedProperties.append(prop);
+        }
+        reallySyncIndex(index, elementDelta);
+        return;
+    }
+    //< NeoScriptTools
     // update or remove existing children
     for (int i = 0; i < node->children.count(); ++i) {
         QScriptDebuggerLocalsModelNode *child = node->children.at(i);
@@ -747,6 +783,72 @@ void QScriptDebuggerLocalsModelPrivate::reallySyncIndex(const QModelIndex &index
     addChildren(index, node, delta.addedProperties);
 }
 
+//> NeoScriptTools
+namespace {
+
+class FetchTextJob : public QScriptDebuggerCommandSchedulerJob
+{
+public:
+    FetchTextJob(const QPersistentModelIndex &index, int count,
+                 QScriptDebuggerCommandSchedulerInterface *scheduler)
+        : QScriptDebuggerCommandSchedulerJob(scheduler),
+          m_index(index), m_count(count)
+    { }
+
+    QScriptDebuggerLocalsModelPrivate *model() const
+    {
+        if (!m_index.isValid())
+            return 0;
+        QAbstractItemModel *m = const_cast<QAbstractItemModel*>(m_index.model());
+        QScriptDebuggerLocalsModel *lm = qobject_cast<QScriptDebuggerLocalsModel*>(m);
+        return QScriptDebuggerLocalsModelPrivate::get(lm);
+    }
+
+    void start()
+    {
+        if (!m_index.isValid()) {
+            // nothing to do, the node has been removed
+            finish();
+            return;
+        }
+        // continue where the text we have ends
+        m_value = model()->nodeFromIndex(m_index)->property.value();
+        QScriptDebuggerCommandSchedulerFrontend frontend(commandScheduler(), this);
+        frontend.scheduleGetStringRange(m_value, m_value.stringValue().length(), m_count);
+    }
+
+    void handleResponse(const QScriptDebuggerResponse &response,
+                        int)
+    {
+        if (m_index.isValid() && (response.error() == QScriptDebuggerResponse::NoError))
+            model()->reallyFetchText(m_index, m_value, response.result().toString());
+        finish();
+    }
+
+private:
+    QPersistentModelIndex m_index;
+    int m_count;
+    QScriptDebuggerValue m_value;
+};
+
+} // namespace
+
+void QScriptDebuggerLocalsModelPrivate::reallyFetchText(const QModelIndex &index,
+                                                        const QScriptDebuggerValue &value,
+                                                        const QString &text)
+{
+    if (!index.isValid())
+        return;
+    QScriptDebuggerLocalsModelNode *node = nodeFromIndex(index);
+    if (node->property.value() != value)
+        return; // the value changed while the text was fetched
+    QScriptDebuggerValue more(value.stringValue() + text, value.stringLength(), value.stringId());
+    node->property = QScriptDebuggerValueProperty(node->property.name(), more,
+                                                  more.stringValue(), node->property.flags());
+    emitDataChanged(index.sibling(index.row(), 0), index.sibling(index.row(), 1));
+}
+//< NeoScriptTools
+
 void QScriptDebuggerLocalsModelPrivate::syncTopLevelNodes()
 {
     Q_Q(QScriptDebuggerLocalsModel);
@@ -814,7 +916,8 @@ int QScriptDebuggerLocalsModel::rowCount(const QModelIndex &parent) const
 {
     Q_D(const QScriptDebuggerLocalsModel);
     // ### need this to make it work with a sortfilterproxymodel (QSFPM is too eager)
-    const_cast<QScriptDebuggerLocalsModel*>(this)->fetchMore(parent);
+    // NeoScriptTools: only populate, further pages are fetched when the view scrolls to them
+    const_cast<QScriptDebuggerLocalsModelPrivate*>(d)->populateIndex(parent);
     QScriptDebuggerLocalsModelNode *node = d->nodeFromIndex(parent);
     return node ? node->children.count() : 0;
 }
@@ -842,6 +945,11 @@ QVariant QScriptDebuggerLocalsModel::data(const QModelIndex &index, int role) co
                 }
                 str = lines.join(QLatin1String("\n"));
             }
+            //> NeoScriptTools
+            QScriptDebuggerValue value = node->property.value();
+            if (value.isTruncated())
+                str.append(QString::fromLatin1(" (... %0 more characters ...)").arg(value.stringLength() - value.stringValue().length()));
+            //< NeoScriptTools
             return str;
         }
     } else if (role == Qt::EditRole) {
@@ -858,6 +966,11 @@ QVariant QScriptDebuggerLocalsModel::data(const QModelIndex &index, int role) co
     } else if (role == Qt::ToolTipRole) {
         if (index.column() == 1) {
             QString str = node->property.valueAsString();
+            //> NeoScriptTools
+            QScriptDebuggerValue value = node->property.value();
+            if (value.isTruncated())
+                return str + QString::fromLatin1("\n(... %0 more characters ...)").arg(value.stringLength() - value.stringValue().length());
+            //< NeoScriptTools
             if (str.indexOf(QLatin1Char('\n')) != -1)
                 return str;
         }
@@ -928,7 +1041,8 @@ Qt::ItemFlags QScriptDebuggerLocalsModel::flags(const QModelIndex &index) const
     if ((index.column() == 1) && index.parent().isValid()) {
         QScriptDebuggerLocalsModelNode *node = d->nodeFromIndex(index);
         //if (!(node->property.flags() & QScriptValue::ReadOnly))
-		if (!(node->property.flags() & 0x00000001))
+		if (!(node->property.flags() & 0x00000001)
+            && !node->property.value().isTruncated()) // NeoScriptTools: editing would cut the string to what was loaded
             ret |= Qt::ItemIsEditable;
     }
     return ret;
@@ -959,7 +1073,8 @@ bool QScriptDebuggerLocalsModel::canFetchMore(const QModelIndex &parent) const
     QScriptDebuggerLocalsModelNode *node = d->nodeFromIndex(parent);
     return node
         && (node->property.value().type() == QScriptDebuggerValue::ObjectValue)
-        && (node->populationState == QScriptDebuggerLocalsModelNode::NotPopulated);
+        && ((node->populationState == QScriptDebuggerLocalsModelNode::NotPopulated)
+            || ((node->populationState == QScriptDebuggerLocalsModelNode::Populated) && node->hasMore)); // NeoScriptTools
 }
 
 /*!
@@ -968,7 +1083,48 @@ bool QScriptDebuggerLocalsModel::canFetchMore(const QModelIndex &parent) const
 void QScriptDebuggerLocalsModel::fetchMore(const QModelIndex &parent)
 {
     Q_D(QScriptDebuggerLocalsModel);
+    //> NeoScriptTools
+    QScriptDebuggerLocalsModelNode *node = d->nodeFromIndex(parent);
+    if (parent.isValid() && (node->populationState == QScriptDebuggerLocalsModelNode::Populated)) {
+        if (!node->hasMore)
+            return;
+        // extend the snapshot by one page, the sync adds the new properties
+        node->hasMore = false;
+        node->fetchLimit += QScriptDebuggerLocalsModelNode::PageSize;
+        d->syncIndex(parent);
+        return;
+    }
+    //< NeoScriptTools
     d->populateIndex(parent);
 }
 
+//> NeoScriptTools
+/*!
+  Returns true if the value at \a index is a string of which only a
+  prefix has been loaded.
+*/
+bool QScriptDebuggerLocalsModel::canFetchMoreText(const QModelIndex &index) const
+{
+    Q_D(const QScriptDebuggerLocalsModel);
+    if (!index.isValid())
+        return false;
+    QScriptDebuggerLocalsModelNode *node = d->nodeFromIndex(index);
+    return node && node->property.value().isTruncated();
+}
+
+/*!
+  Loads the next part of the string at \a index, or all of the rest
+  if \a all is true.
+*/
+void QScriptDebuggerLocalsModel::fetchMoreText(const QModelIndex &index, bool all)
+{
+    Q_D(QScriptDebuggerLocalsModel);
+    if (!canFetchMoreText(index))
+        return;
+    QScriptDebuggerJob *job = new FetchTextJob(index, all ? -1 : int(QScriptDebuggerLocalsModelNode::TextPageSize),
+                                               d->commandScheduler);
+    d->jobScheduler->scheduleJob(job);
+}
+//< NeoScriptTools
+
 QT_END_NAMESPACE
@@ -89,6 +89,11 @@ public:
     bool canFetchMore(const QModelIndex &parent) const;
     void fetchMore(const QModelIndex &parent);
 
+    //> NeoScriptTools
+    bool canFetchMoreText(const QModelIndex &index) const;
+    void fetchMoreText(const QModelIndex &index, bool all = false);
+    //< NeoScriptTools
+
 Q_SIGNALS:
     void scopeObjectAvailable(const QModelIndex &index);
 
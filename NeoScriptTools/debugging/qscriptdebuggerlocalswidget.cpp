@@ -56,6 +56,7 @@
 #include <QtGui/qlineedit.h>
 #include <QtGui/qstyleditemdelegate.h>
 #include <QtGui/qmessagebox.h>
+#include <QtGui/qmenu.h>
 #else
 #include <QtWidgets/qheaderview.h>
 #include <QtWidgets/qcompleter.h>
@@ -66,6 +67,7 @@
 #include <QtWidgets/qlineedit.h>
 #include <QtWidgets/qstyleditemdelegate.h>
 #include <QtWidgets/qmessagebox.h>
+#include <QtWidgets/qmenu.h>
 #endif
 #include <QtGui/qevent.h>
 
@@ -181,6 +183,28 @@ void QScriptDebuggerLocalsWidgetPrivate::_q_expandIndex(const QModelIndex &index
         view->expand(proxy->mapFromSource(index));
 }
 
+//> NeoScriptTools
+void QScriptDebuggerLocalsWidgetPrivate::_q_onContextMenuRequested(const QPoint &pos)
+{
+    // long strings are only loaded in part, the rest is fetched on request
+    Q_Q(QScriptDebuggerLocalsWidget);
+    QScriptDebuggerLocalsModel *model = q->localsModel();
+    if (!model)
+        return;
+    QModelIndex index = proxy->mapToSource(view->indexAt(pos));
+    if (!model->canFetchMoreText(index))
+        return;
+    QMenu menu;
+    QAction *moreAction = menu.addAction(QScriptDebuggerLocalsWidget::tr("Load More Text"));
+    QAction *allAction = menu.addAction(QScriptDebuggerLocalsWidget::tr("Load Full Text"));
+    QAction *action = menu.exec(view->viewport()->mapToGlobal(pos));
+    if (action == moreAction)
+        model->fetchMoreText(index);
+    else if (action == allAction)
+        model->fetchMoreText(index, true);
+}
+//< NeoScriptTools
+
 QScriptDebuggerLocalsItemDelegate::QScriptDebuggerLocalsItemDelegate(
     QObject *parent)
     : QStyledItemDelegate(parent)
@@ -315,6 +339,9 @@ QScriptDebuggerLocalsWidget::QScriptDebuggerLocalsWidget(QWidget *parent)
     d->view->setSelectionBehavior(QAbstractItemView::SelectRows);
     d->view->setSortingEnabled(true);
     d->view->header()->setDefaultAlignment(Qt::AlignLeft);
+    d->view->setContextMenuPolicy(Qt::CustomContextMenu); // NeoScriptTools
+    QObject::connect(d->view, SIGNAL(customContextMenuRequested(QPoint)),
+                     this, SLOT(_q_onContextMenuRequested(QPoint)));
 //    d->view->header()->setSortIndicatorShown(true);
 //    d->view->header()->setResizeMode(QHeaderView::ResizeToContents);
 
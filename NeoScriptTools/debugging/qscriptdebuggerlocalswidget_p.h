@@ -82,6 +82,7 @@ private:
     Q_PRIVATE_SLOT(d_func(), void _q_onCompletionTaskFinished())
     Q_PRIVATE_SLOT(d_func(), void _q_insertCompletion(const QString &))
     Q_PRIVATE_SLOT(d_func(), void _q_expandIndex(const QModelIndex &))
+    Q_PRIVATE_SLOT(d_func(), void _q_onContextMenuRequested(const QPoint &)) // NeoScriptTools
 };
 
 #include "qscriptdebuggerlocalswidget_p_p.h"
@@ -99,6 +99,7 @@ public:
     void _q_onCompletionTaskFinished();
     void _q_insertCompletion(const QString &text);
     void _q_expandIndex(const QModelIndex &index);
+    void _q_onContextMenuRequested(const QPoint &pos); // NeoScriptTools
 
     QTreeView *view;
     QPointer<QLineEdit> completingEditor;
@@ -70,6 +70,8 @@ public:
     QScriptDebuggerValuePropertyList addedProperties;
 
     //> NeoScriptTools
+    bool hasMore = false; // the capture was limited and the object has further properties
+    bool isBinary = false; // the added properties are the decoded elements of a typed array, not a delta
     void fromVariant(const QVariantMap& in);
     QVariant toVariant() const;
     //< NeoScriptTools
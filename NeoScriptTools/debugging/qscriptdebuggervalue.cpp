@@ -68,10 +68,14 @@ public:
         double numberValue;
         qint64 objectId;
     };
+    //> NeoScriptTools
+    qint64 stringLength; // the full length when stringValue holds only a prefix, -1 otherwise
+    qint64 stringId; // the backend's handle for fetching the rest of a truncated string
+    //< NeoScriptTools
 };
 
 QScriptDebuggerValuePrivate::QScriptDebuggerValuePrivate()
-    : type(QScriptDebuggerValue::NoValue)
+    : type(QScriptDebuggerValue::NoValue), stringLength(-1), stringId(0)
 {
 }
 
@@ -125,6 +129,20 @@ QScriptDebuggerValue::QScriptDebuggerValue(ValueType type)
     d_ptr->ref.ref();
 }
 
+//> NeoScriptTools
+QScriptDebuggerValue::QScriptDebuggerValue(const QString &prefix, qint64 length, qint64 stringId)
+    : d_ptr(new QScriptDebuggerValuePrivate)
+{
+    d_ptr->type = StringValue;
+    d_ptr->stringValue = new QString(prefix);
+    if (length > prefix.length()) {
+        d_ptr->stringLength = length;
+        d_ptr->stringId = stringId;
+    }
+    d_ptr->ref.ref();
+}
+//< NeoScriptTools
+
 QScriptDebuggerValue::QScriptDebuggerValue(const QScriptDebuggerValue &other)
     : d_ptr(other.d_ptr.data())
 {
@@ -201,6 +219,41 @@ qint64 QScriptDebuggerValue::objectId() const
     return d->objectId;
 }
 
+//> NeoScriptTools
+/*!
+  Returns true if this is a string value of which only a prefix is
+  known, the rest can be fetched with a GetStringRange command.
+*/
+bool QScriptDebuggerValue::isTruncated() const
+{
+    Q_D(const QScriptDebuggerValue);
+    return d && (d->type == StringValue) && (d->stringLength >= 0);
+}
+
+/*!
+  Returns the full length of this string value.
+*/
+qint64 QScriptDebuggerValue::stringLength() const
+{
+    Q_D(const QScriptDebuggerValue);
+    if (!d)
+        return 0;
+    Q_ASSERT(d->type == StringValue);
+    return d->stringLength >= 0 ? d->stringLength : d->stringValue->length();
+}
+
+/*!
+  Returns the ID of a truncated string value.
+*/
+qint64 QScriptDebuggerValue::stringId() const
+{
+    Q_D(const QScriptDebuggerValue);
+    if (!d)
+        return 0;
+    return d->stringId;
+}
+//< NeoScriptTools
+
 /*!
   Returns a string representation of this value.
 */
@@ -253,7 +306,8 @@ bool QScriptDebuggerValue::operator==(const QScriptDebuggerValue &other) const
     case BooleanValue:
         return d->booleanValue == od->booleanValue;
     case StringValue:
-        return *d->stringValue == *od->stringValue;
+        return *d->stringValue == *od->stringValue
+            && d->stringLength == od->stringLength; // NeoScriptTools
     case NumberValue:
         return d->numberValue == od->numberValue;
     case ObjectValue:
@@ -289,6 +343,11 @@ void QScriptDebuggerValue::fromVariant(const QVariantMap& in)
 	{
 		d_ptr->type = QScriptDebuggerValue::StringValue;
 		d_ptr->stringValue = new QString(in["value"].toString());
+		if(in.contains("ref")) // only a prefix was sent
+		{
+			d_ptr->stringLength = in["length"].toLongLong();
+			d_ptr->stringId = in["ref"].toLongLong();
+		}
 	}
 	else if(strType == "NumberValue")
 	{
@@ -326,6 +385,11 @@ QVariantMap QScriptDebuggerValue::toVariant() const
     case QScriptDebuggerValue::StringValue:
 		out["type"] = "StringValue";
         out["value"] = stringValue();
+		if(isTruncated())
+		{
+			out["length"] = stringLength();
+			out["ref"] = stringId();
+		}
         break;
     case QScriptDebuggerValue::NumberValue:
 		out["type"] = "NumberValue";
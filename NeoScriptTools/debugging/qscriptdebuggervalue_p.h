@@ -87,6 +87,7 @@ public:
     QScriptDebuggerValue(const QString &value);
     QScriptDebuggerValue(qint64 objectId);
     QScriptDebuggerValue(ValueType type);
+    QScriptDebuggerValue(const QString &prefix, qint64 length, qint64 stringId); // NeoScriptTools
     QScriptDebuggerValue(const QScriptDebuggerValue &other);
     ~QScriptDebuggerValue();
 
@@ -99,6 +100,12 @@ public:
     QString stringValue() const;
     qint64 objectId() const;
 
+	//> NeoScriptTools
+	bool isTruncated() const;
+	qint64 stringLength() const;
+	qint64 stringId() const;
+	//< NeoScriptTools
+
     QString toString() const;
 
     bool operator==(const QScriptDebuggerValue &other) const;
@@ -46,6 +46,7 @@
 #include <QtCore/qshareddata.h>
 #include <QtCore/qdatastream.h>
 #include <QtCore/qstring.h>
+#include <QtCore/qendian.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -236,6 +237,76 @@ QDataStream &operator>>(QDataStream &in, QScriptDebuggerValueProperty &property)
 }
 
 //> NeoScriptTools
+template <typename T>
+static double readElement(const uchar *data, bool bigEndian)
+{
+    return bigEndian ? qFromBigEndian<T>(data) : qFromLittleEndian<T>(data);
+}
+
+static int binaryElementSize(const QString& type)
+{
+    if (type == QLatin1String("Float64Array") || type == QLatin1String("BigInt64Array") || type == QLatin1String("BigUint64Array"))
+        return 8;
+    if (type == QLatin1String("Float32Array") || type == QLatin1String("Int32Array") || type == QLatin1String("Uint32Array"))
+        return 4;
+    if (type == QLatin1String("Int16Array") || type == QLatin1String("Uint16Array"))
+        return 2;
+    if (type == QLatin1String("Int8Array") || type == QLatin1String("Uint8Array") || type == QLatin1String("Uint8ClampedArray")
+        || type == QLatin1String("ArrayBuffer"))
+        return 1;
+    return 0; // unknown element types are not decoded
+}
+
+static QScriptDebuggerValuePropertyList decodeBinary(const QVariantMap& in)
+{
+    // the elements of a typed array come as raw bytes, turn them into one property per element
+    QScriptDebuggerValuePropertyList props;
+    QString type = in["elementType"].toString();
+    int size = in["elementSize"].toInt();
+    qint64 from = in["from"].toLongLong();
+    bool bigEndian = in["bigEndian"].toBool();
+    QByteArray bytes = in["bytes"].toByteArray();
+    if (size <= 0 || size != binaryElementSize(type))
+        return props;
+
+    const uchar *data = reinterpret_cast<const uchar*>(bytes.constData());
+    int count = bytes.size() / size;
+    props.reserve(count);
+    for (int i = 0; i < count; ++i, data += size) {
+        double value;
+        QString text; // 64 bit integers do not fit into a double, so they are shown exactly
+        if (type == QLatin1String("Float64Array"))
+            value = readElement<double>(data, bigEndian);
+        else if (type == QLatin1String("Float32Array"))
+            value = readElement<float>(data, bigEndian);
+        else if (type == QLatin1String("Int32Array"))
+            value = readElement<qint32>(data, bigEndian);
+        else if (type == QLatin1String("Uint32Array"))
+            value = readElement<quint32>(data, bigEndian);
+        else if (type == QLatin1String("Int16Array"))
+            value = readElement<qint16>(data, bigEndian);
+        else if (type == QLatin1String("Uint16Array"))
+            value = readElement<quint16>(data, bigEndian);
+        else if (type == QLatin1String("BigInt64Array")) {
+            qint64 number = bigEndian ? qFromBigEndian<qint64>(data) : qFromLittleEndian<qint64>(data);
+            value = number;
+            text = QString::number(number);
+        }
+        else if (type == QLatin1String("BigUint64Array")) {
+            quint64 number = bigEndian ? qFromBigEndian<quint64>(data) : qFromLittleEndian<quint64>(data);
+            value = number;
+            text = QString::number(number);
+        }
+        else if (type == QLatin1String("Int8Array"))
+            value = qint8(*data);
+        else // Uint8Array, Uint8ClampedArray and ArrayBuffer
+            value = *data;
+        QScriptDebuggerValue element(value);
+        props.append(QScriptDebuggerValueProperty(QString::number(from + i), element, text.isNull() ? element.toString() : text, 0));
+    }
+    return props;
+}
+
 void QScriptDebuggerObjectSnapshotDelta::fromVariant(const QVariantMap& in)
 {
     removedProperties = in["removedProperties"].toStringList();
@@ -249,6 +320,11 @@ void QScriptDebuggerObjectSnapshotDelta::fromVariant(const QVariantMap& in)
         data.fromVariant(var.toMap());
         addedProperties.append(data);
     }
+    hasMore = in["hasMore"].toBool();
+    if (in.contains("binary")) {
+        addedProperties = decodeBinary(in["binary"].toMap());
+        isBinary = true;
+    }
 }
 
 QVariant QScriptDebuggerObjectSnapshotDelta::toVariant() const
@@ -263,6 +339,7 @@ QVariant QScriptDebuggerObjectSnapshotDelta::toVariant() const
     foreach(QScriptDebuggerValueProperty prop, addedProperties)
         added.append(prop.toVariant());
     out["addedProperties"] = added;
+    out["hasMore"] = hasMore;
     return out;
 }
 //< NeoScriptTools
@@ -0,0 +1,21 @@
+# ----------------------------------------------------
+# Adds, looks up and releases debugger refs of many distinct objects through CV4DebugHandler,
+# reports the timings and fails when a ref is not found again or a released slot is not reused.
+# Run with an optional ref count: RefBenchmark [refs]
+# ----------------------------------------------------
+
+TEMPLATE = app
+TARGET = RefBenchmark
+QT = core qml qml-private
+CONFIG += console
+CONFIG -= app_bundle
+DEFINES += V4SCRIPTDEBUGGER_LIB # the handler is compiled in, not imported from the library
+INCLUDEPATH += .
+DEPENDPATH += .
+
+CONFIG(debug, debug|release):DESTDIR = ../../Debug
+CONFIG(release, debug|release):DESTDIR = ../../Release
+
+HEADERS += ../V4DebugHandler.h
+SOURCES += ../V4DebugHandler.cpp \
+    ./main.cpp
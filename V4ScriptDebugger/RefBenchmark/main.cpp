@@ -0,0 +1,126 @@
+/****************************************************************************
+**
+** Copyright (C) 2023 David Xanatos (xanasoft.com) All rights reserved.
+** Contact: XanatosDavid@gmil.com
+**
+**
+** To use the V4ScriptTools in a commercial project, you must obtain
+** an appropriate business use license.
+**
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+**
+**
+****************************************************************************/
+
+// Adds refs for many distinct objects to CV4DebugHandler, looks them up again and releases them,
+// fails when an existing object gets a new ref or the released slots are not reused, and reports the timings
+// next to the linear scan over the ref array which the identity index replaced.
+
+#include <QCoreApplication>
+#include <QJSEngine>
+#include <QElapsedTimer>
+#include <QVector>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <private/qv4engine_p.h>
+#include <private/qv4object_p.h>
+#include <private/qv4scopedvalue_p.h>
+
+#include "../V4DebugHandler.h"
+
+enum { ScanLookups = 1000 }; // the linear scan is quadratic, so only a sample of lookups is timed
+
+static void report(const char* name, qint64 nsecs, int count)
+{
+	printf("%-28s %10d %12.3f %12.1f\n", name, count, nsecs / 1000000.0, double(nsecs) / qMax(1, count));
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	int count = argc > 1 ? atoi(argv[1]) : 100000;
+	if (count < 1)
+		count = 1;
+
+	QJSEngine jsEngine;
+	QV4::ExecutionEngine* engine = jsEngine.handle();
+	CV4DebugHandler handler(engine);
+
+	QV4::Scope scope(engine);
+	QV4::ScopedObject objects(scope, engine->newArrayObject());
+	QV4::ScopedValue v(scope);
+	for (int i = 0; i < count; i++) {
+		v = engine->newObject();
+		objects->put(uint(i), v);
+	}
+
+	printf("%-28s %10s %12s %12s\n", "operation", "count", "total ms", "ns per op");
+
+	bool found = true;
+	bool reused = true;
+	QVector<uint> refs(count);
+	QElapsedTimer timer;
+
+	timer.start();
+	for (int i = 0; i < count; i++) {
+		v = objects->get(uint(i));
+		refs[i] = handler.addRef(v);
+	}
+	report("add new", timer.nsecsElapsed(), count);
+
+	timer.restart();
+	for (int i = 0; i < count; i++) {
+		v = objects->get(uint(i));
+		if (handler.addRef(v) != refs[i])
+			found = false;
+	}
+	report("add existing (lookup)", timer.nsecsElapsed(), count);
+	if (!found)
+		printf("an existing object got a new ref FAILED\n");
+
+	timer.restart();
+	for (int i = 0; i < count; i++)
+		v = handler.getValue(refs[i]);
+	report("get value", timer.nsecsElapsed(), count);
+
+	// what addRef did before the index, compare against every slot of the ref array
+	int lookups = qMin(count, int(ScanLookups));
+	QV4::ScopedValue slot(scope);
+	timer.restart();
+	for (int i = 0; i < lookups; i++) {
+		v = objects->get(uint(count - 1 - i));
+		for (int j = 0; j < count; j++) {
+			slot = handler.getValue(uint(j));
+			if (slot->rawValue() == v->rawValue())
+				break;
+		}
+	}
+	report("linear scan (old lookup)", timer.nsecsElapsed(), lookups);
+
+	timer.restart();
+	handler.releaseRefs();
+	report("release all", timer.nsecsElapsed(), count);
+
+	// the released slots are handed out again, so the ref array does not grow
+	timer.restart();
+	for (int i = 0; i < count; i++) {
+		v = objects->get(uint(i));
+		if (handler.addRef(v) >= uint(count))
+			reused = false;
+	}
+	report("add after release", timer.nsecsElapsed(), count);
+	if (!reused)
+		printf("released slots were not reused FAILED\n");
+
+	return found && reused ? 0 : 1;
+}
@@ -22,20 +22,17 @@
 
 #include "V4DebugAgent.h"
 #include <QThread>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QDeadlineTimer>
+#include <QTimer>
+#include <QJSEngine>
+#include <QDebug>
 
 #include <private/qv4script_p.h>
 
 #include "V4DebugJobs.h"
-
-inline uint qHash(const CV4DebugAgent::SBreakKey& v, uint seed = 0)
-{
-	return v.lineNumber ^ qHash(v.fileName, seed);
-}
-
-inline bool operator==(const CV4DebugAgent::SBreakKey& l, const CV4DebugAgent::SBreakKey& r)
-{
-	return l.lineNumber == r.lineNumber && l.fileName == r.fileName;
-}
+#include "V4ScriptDebuggerApi.h"
 
 void SV4Breakpoint::fromVariant(const QVariantMap& in)
 {
@@ -46,7 +43,10 @@ void SV4Breakpoint::fromVariant(const QVariantMap& in)
 	ignoreCount = in["ignoreCount"].toInt();
 	condition = in["condition"].toString();
 	data = in["data"];
+	scriptId = in.value("scriptId", -1).toLongLong();
 	hitCount = in["hitCount"].toInt();
+	conditionTime = in["conditionTime"].toLongLong();
+	logMessage = in["logMessage"].toString();
 }
 
 QVariantMap SV4Breakpoint::toVariant() const
@@ -59,7 +59,10 @@ QVariantMap SV4Breakpoint::toVariant() const
 	out["ignoreCount"] = ignoreCount;
 	out["condition"] = condition;
 	out["data"] = data;
+	out["scriptId"] = scriptId;
 	out["hitCount"] = hitCount;
+	out["conditionTime"] = conditionTime;
+	out["logMessage"] = logMessage;
 	return out;
 }
 
@@ -68,21 +71,62 @@ QVariantMap SV4Breakpoint::toVariant() const
 // CV4DebugAgent
 //
 
-CV4DebugAgent::CV4DebugAgent(QV4::ExecutionEngine* engine) 
+CV4DebugAgent::CV4DebugAgent(CV4EngineItf* engine) 
 {
-	m_engine = engine;
+	m_engine = engine->self()->handle();
+	m_scripts = engine;
+	m_attached.storeRelaxed(1);
+	m_wasAttached = true;
 	m_breakOnException = false;
 	m_pauseRequested = DontBreak;
 	m_paused = false;
-	m_currentFrame = nullptr;
+	m_resumed = false;
 	m_steppingMode = NotStepping;
+	m_stepDepth = 0;
+	m_depth = 0;
 	m_breakpointIdCtr = 0;
-	m_haveBreakpoints = 0;
+	m_runUntilLine = -1;
+	m_breakTableSerial = 0;
+	m_readerSerial.storeRelaxed(0);
 	m_runningJob = nullptr;
+	m_jobRetryPending = false;
+	m_evaluating = false;
+	m_lastUnit = nullptr;
+	m_lastUnitInfo = nullptr;
+	m_scriptIdStack.reserve(64);
+	m_currentScriptsValid = false;
+	m_frameCount = 0;
+}
 
+void CV4DebugAgent::install()
+{
+	// Note: must be called from the engine thread, as the engine may be running script
+	if (m_engine->debugger() == this)
+		return;
+	if (m_engine->debugger()) {
+		qWarning() << "The engine already has a different debugger installed";
+		setParent(m_engine->jsEngine()); // not installed, so let the engine's owner dispose of us
+		return;
+	}
 	m_engine->setDebugger(this);
 }
 
+CV4DebugAgent::~CV4DebugAgent()
+{
+	QMutexLocker locker(&m_mutex);
+	for (const CV4JobFuture& future : m_jobQueue)
+		future->state = SV4JobState::eCanceled;
+	m_jobQueue.clear();
+	m_jobWaiter.wakeAll();
+	locker.unlock();
+
+	delete m_breakTable.loadRelaxed();
+	qDeleteAll(m_retiredTables);
+	qDeleteAll(m_conditions);
+	qDeleteAll(m_retiredConditions);
+	qDeleteAll(m_logScripts);
+}
+
 void CV4DebugAgent::pause(PauseReason reason)
 {
 	QMutexLocker locker(&m_mutex);
@@ -97,12 +141,13 @@ void CV4DebugAgent::resume(Stepping stepping)
 	if (!m_paused)
 		return;
 
-	m_currentFrame = m_engine->currentStackFrame;
+	m_stepDepth = m_depth; // the engine is paused, so we can read its depth
 	m_steppingMode = stepping;
+	m_resumed = true;
 	m_engineWaiter.wakeAll();
 }
 
-void CV4DebugAgent::runJobInEngine(class CV4DebugJob* job, bool bWait)
+CV4JobFuture CV4DebugAgent::scheduleJob(const QSharedPointer<CV4DebugJob>& job)
 {
 	QMutexLocker locker(&m_mutex);
 
@@ -111,60 +156,397 @@ void CV4DebugAgent::runJobInEngine(class CV4DebugJob* job, bool bWait)
 	// the user of this agent must ensure that it always lives in the same thread as the engine.
 	Q_ASSERT(QThread::currentThread() != QObject::thread());
 
-	m_runningJob = job; // schedule job
+	CV4JobFuture future(new SV4JobState);
+	future->job = job;
+	m_jobQueue.append(future);
+	if (job->isReadOnly())
+		m_jobsPending.storeRelease(1); // a running engine picks the job up at its next safepoint
+
 	if (m_paused) // resume engine when paused, signalAndWait will run the job
 		m_engineWaiter.wakeAll(); 
-	else // invoke function in the engines thread
+	else // and in case no script is executing, invoke function in the engines thread
 		QMetaObject::invokeMethod(this, "runJob", Qt::QueuedConnection);
-		/*QMetaObject::invokeMethod(this, [&](){
-				runJob(); // or like this
-			}, Qt::QueuedConnection);*/
-		
-	if (bWait)
-		m_jobWaiter.wait(&m_mutex);
+	return future;
+}
+
+bool CV4DebugAgent::waitForJob(const CV4JobFuture& future, int timeoutMs)
+{
+	QMutexLocker locker(&m_mutex);
+
+	QDeadlineTimer deadline = timeoutMs < 0 ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer(timeoutMs);
+	while (future->state == SV4JobState::eQueued || future->state == SV4JobState::eRunning) {
+		if (!m_jobWaiter.wait(&m_mutex, deadline))
+			return future->state == SV4JobState::eFinished || future->state == SV4JobState::eCanceled;
+	}
+	return true;
+}
+
+bool CV4DebugAgent::cancelJob(const CV4JobFuture& future)
+{
+	QMutexLocker locker(&m_mutex);
+
+	switch (future->state) {
+	case SV4JobState::eQueued:
+		m_jobQueue.removeOne(future);
+		future->state = SV4JobState::eCanceled;
+		return true;
+	case SV4JobState::eRunning:
+	{
+		// the job may be stuck in a long script, interrupt it, the engine thread clears the interruption when the job returns
+		if (!future->interrupted) {
+			future->interrupted = true;
+			m_scripts->self()->setInterrupted(true);
+		}
+		// a native call does not see the interruption, as the future owns the job we can abandon it when it does not return in time
+		QDeadlineTimer deadline(CancelTimeout);
+		while (future->state == SV4JobState::eRunning) {
+			if (!m_jobWaiter.wait(&m_mutex, deadline))
+				return true;
+		}
+		return future->state == SV4JobState::eCanceled;
+	}
+	default:
+		return false;
+	}
+}
+
+bool CV4DebugAgent::runJobInEngine(const QSharedPointer<CV4DebugJob>& job, int timeoutMs)
+{
+	CV4JobFuture future = scheduleJob(job);
+	if (!waitForJob(future, timeoutMs))
+		cancelJob(future);
+	return future->state == SV4JobState::eFinished;
 }
 
 void CV4DebugAgent::runJob()
 {
 	QMutexLocker locker(&m_mutex);
 
-	if (m_runningJob) {
-		//m_mutex.unlock();
+	// a nested event loop may run while script is executing, the jobs left queued then run at the next pause, 
+	//	or once the engine is back in its event loop, so check back on them until then
+	runQueuedJobs(m_engine->currentStackFrame != nullptr);
+	if (!m_jobQueue.isEmpty() && !m_jobRetryPending) {
+		m_jobRetryPending = true;
+		QTimer::singleShot(JobRetryInterval, this, [this]() {
+			m_jobRetryPending = false;
+			runJob();
+		});
+	}
+}
+
+void CV4DebugAgent::runQueuedJobs(bool running)
+{
+	// Note: must be called from the engine thread with m_mutex held, the mutex is released while a job runs 
+	//	so that a waiting thread can time out and interrupt it
+	reclaimRetired();
+
+	QV4::Scope scope(m_engine);
+	QV4::ScopedValue exception(scope);
+	for (int i = 0; i < m_jobQueue.size(); ) {
+		// a running engine is somewhere in the middle of a statement, so only jobs which do not change the script's state run now
+		if (running && !m_jobQueue[i]->job->isReadOnly()) {
+			i++;
+			continue;
+		}
+
+		CV4JobFuture future = m_jobQueue.takeAt(i);
+		future->state = SV4JobState::eRunning;
+		m_runningJob = future->job.data();
+
+		// the job must neither see nor clear an exception the engine is about to throw
+		quint8 hadException = m_engine->hasException;
+		exception = *m_engine->exceptionValue;
+		m_engine->hasException = false;
+
+		m_mutex.unlock();
 		m_runningJob->run();
-		//m_mutex.lock();
+		m_mutex.lock();
+
+		if (m_engine->hasException)
+			m_engine->catchException();
+		m_engine->hasException = hadException;
+		*m_engine->exceptionValue = exception->asReturnedValue();
+
+		m_runningJob = nullptr;
+		if (future->interrupted) {
+			m_scripts->self()->setInterrupted(false);
+			future->state = SV4JobState::eCanceled;
+		} else
+			future->state = SV4JobState::eFinished;
+		m_jobWaiter.wakeAll();
 	}
-	m_jobWaiter.wakeAll();
-	m_runningJob = nullptr;
+	m_jobsPending.storeRelaxed(0);
 }
 
 void CV4DebugAgent::runUntil(const QString& fileName, int lineNumber)
 {
 	QMutexLocker locker(&m_mutex);
 
-	clearRunUntil();
-	// set a dummy breakpoint
-	m_breakpointHash.insert(SBreakKey(fileName, lineNumber), (SV4Breakpoint*)-1);
+	// set a dummy break location
+	m_runUntilFile = scriptName(fileName);
+	m_runUntilLine = lineNumber;
+	publishBreakTable();
 }
 
 void CV4DebugAgent::clearRunUntil()
 {
-	auto keys = m_breakpointHash.keys((SV4Breakpoint*)-1);
-	while (!keys.isEmpty())
-		m_breakpointHash.remove(keys.takeFirst());
+	if (m_runUntilLine == -1)
+		return;
+	m_runUntilFile.clear();
+	m_runUntilLine = -1;
+	publishBreakTable();
 }
 
-QV4::CppStackFrame* CV4DebugAgent::findFrame(QV4::ExecutionEngine* engine, int frameNr)
+void CV4DebugAgent::publishBreakTable()
+{
+	// Note: m_mutex must be held, the table is rebuilt on every change as breakpoints change rarely 
+	//	compared to how often the engine thread looks them up
+	SBreakTable* table = nullptr;
+	auto addLine = [&](const QString& fileName, int lineNumber) -> SScriptBreaks& {
+		if (!table) {
+			table = new SBreakTable;
+			table->serial = ++m_breakTableSerial;
+		}
+		SScriptBreaks& breaks = table->scripts[fileName];
+		if (lineNumber >= breaks.lines.size())
+			breaks.lines.resize(lineNumber + 1);
+		breaks.lines.setBit(lineNumber);
+		return breaks;
+	};
+	for (auto I = m_breakpoints.begin(); I != m_breakpoints.end(); ++I) {
+		if (!I->enabled || I->lineNumber < 0)
+			continue;
+		SScriptBreaks& breaks = addLine(scriptName(I->fileName), I->lineNumber);
+		if (!I->logMessage.isEmpty())
+			breaks.logpoints.insert(I->lineNumber, SScriptBreaks::SLogPoint{ I.key(), I->logMessage, logProgram(I->logMessage) });
+		else
+			breaks.breakpoints.insert(I->lineNumber, I.key());
+	}
+	if (m_runUntilLine >= 0)
+		addLine(m_runUntilFile, m_runUntilLine).runUntilLine = m_runUntilLine;
+
+	SBreakTable* old = m_breakTable.fetchAndStoreOrdered(table);
+	if (old) {
+		if (m_paused) // the engine thread is waiting for us, so it can not be reading the old table
+			delete old;
+		else
+			m_retiredTables.append(old);
+	}
+
+	// free the retired tables here without waiting for the next job or pause
+	reclaimRetiredTables();
+}
+
+void CV4DebugAgent::reclaimRetiredTables()
+{
+	// Note: m_mutex must be held, only tables older than the last one the engine thread resolved breaks from
+	//	are no longer referenced, the engine may still be using the breaks of that one further up its stack
+	quint64 readerSerial = m_readerSerial.loadAcquire();
+	for (auto I = m_retiredTables.begin(); I != m_retiredTables.end();) {
+		if ((*I)->serial < readerSerial) {
+			delete *I;
+			I = m_retiredTables.erase(I);
+		} else
+			++I;
+	}
+}
+
+void CV4DebugAgent::reclaimRetired()
+{
+	// Note: must be called from the engine thread with m_mutex held
+	reclaimRetiredTables();
+	if (m_evaluating) // reached from a nested event loop while a logpoint message is being evaluated
+		return;
+	qDeleteAll(m_retiredConditions);
+	m_retiredConditions.clear();
+
+	for (auto I = m_logScripts.begin(); I != m_logScripts.end();) {
+		auto B = m_breakpoints.find(I.key());
+		if (B == m_breakpoints.end() || B->logMessage.isEmpty()) {
+			delete I.value();
+			I = m_logScripts.erase(I);
+		} else
+			++I;
+	}
+}
+
+bool CV4DebugAgent::evaluateCondition(int id, const QString& condition)
+{
+	// Note: must be called from the engine thread with m_mutex held
+	reclaimRetired();
+
+	bool strictMode = m_engine->currentStackFrame->v4Function->isStrict();
+	CV4CompiledScript*& compiled = m_conditions[id];
+	if (compiled && !compiled->isCompiledFor(condition, strictMode)) {
+		delete compiled;
+		compiled = nullptr;
+	}
+	if (!compiled)
+		compiled = new CV4CompiledScript(m_engine, condition, strictMode);
+
+	// a condition that fails to compile or throws breaks, just like an error object would evaluate to true
+	if (!compiled->isValid())
+		return true;
+	QV4::Scope scope(m_engine);
+	QV4::ScopedValue result(scope, compiled->run(m_engine));
+	if (m_engine->hasException) {
+		m_engine->catchException();
+		return true;
+	}
+	return result->toBoolean();
+}
+
+void CV4DebugAgent::dropCondition(int id)
+{
+	// the compiled script holds engine values, so let the engine thread free it
+	if (CV4CompiledScript* compiled = m_conditions.take(id))
+		m_retiredConditions.append(compiled);
+}
+
+QString CV4DebugAgent::logProgram(const QString& message)
+{
+	// turn "x is {x}" into the template literal `x is ${x}`
+	QString program = "`";
+	int depth = 0;
+	for (QChar c : message) {
+		if (depth == 0) {
+			if (c == '{') {
+				program += "${";
+				depth++;
+				continue;
+			}
+			if (c == '`' || c == '\\' || c == '$')
+				program += '\\';
+		}
+		else if (c == '{')
+			depth++;
+		else if (c == '}')
+			depth--;
+		program += c;
+	}
+	program += "`";
+	return program;
+}
+
+void CV4DebugAgent::writeLog(const SScriptBreaks::SLogPoint& logpoint, int lineNumber)
+{
+	// Note: this is called by the engine thread without holding m_mutex, the record goes to the 
+	//	lock free log buffer which the backend drains when it is signaled or polls for events
+	bool strictMode = m_engine->currentStackFrame->v4Function->isStrict();
+	CV4CompiledScript*& compiled = m_logScripts[logpoint.id];
+	if (compiled && !compiled->isCompiledFor(logpoint.program, strictMode)) {
+		delete compiled;
+		compiled = nullptr;
+	}
+	if (!compiled)
+		compiled = new CV4CompiledScript(m_engine, logpoint.program, strictMode);
+
+	QString message;
+	if (compiled->isValid()) {
+		m_evaluating = true;
+		QV4::Scope scope(m_engine);
+		QV4::ScopedValue result(scope, compiled->run(m_engine));
+		if (m_engine->hasException)
+			result = m_engine->catchException();
+		message = result->toQStringNoThrow();
+		m_evaluating = false;
+	} else
+		message = logpoint.message;
+
+	m_logBuffer.push(SV4LogRecord{ QDateTime::currentMSecsSinceEpoch(), unitInfo(m_engine->currentStackFrame->v4Function).scriptId, lineNumber, message });
+	if (m_logBuffer.needsWakeup())
+		emit logRecordsAvailable();
+}
+
+QV4::CppStackFrame* CV4DebugAgent::parentFrame(QV4::CppStackFrame* frame)
 {
-	QV4::CppStackFrame* frame = engine->currentStackFrame;
-	for (int i = 0; frame && i < frameNr; i++)
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-		frame = frame->parent;
+	return frame->parent;
 #else
-		frame = frame->parentFrame();
+	return frame->parentFrame();
 #endif
+}
+
+QV4::CppStackFrame* CV4DebugAgent::findFrame(QV4::ExecutionEngine* engine, int frameNr)
+{
+	QV4::CppStackFrame* frame = engine->currentStackFrame;
+	for (int i = 0; frame && i < frameNr; i++)
+		frame = parentFrame(frame);
 	return frame;
 }
 
+int CV4DebugAgent::frameCount()
+{
+	QMutexLocker locker(&m_mutex);
+	if (!m_paused) // engine must be paused as we access it here
+		return 0;
+
+	if (m_frameCount == -1) {
+		m_frameCount = 0;
+		for (QV4::CppStackFrame* frame = m_engine->currentStackFrame; frame; frame = parentFrame(frame))
+			m_frameCount++;
+	}
+	return m_frameCount;
+}
+
+QVector<SV4StackFrame> CV4DebugAgent::stackFrames(int from, int count)
+{
+	QMutexLocker locker(&m_mutex);
+	QVector<SV4StackFrame> frames;
+	if (!m_paused || from < 0) // engine must be paused as we access it here
+		return frames;
+
+	for (int i = from; count < 0 || i < from + count; i++) {
+		QV4::CppStackFrame* frame = pausedFrame(i);
+		if (!frame)
+			break;
+		frames.append(stackFrame(i, frame));
+	}
+	return frames;
+}
+
+QV4::CppStackFrame* CV4DebugAgent::pausedFrame(int frameNr)
+{
+	// Note: m_mutex must be held and the engine paused, the walked frames are kept so paging through a deep stack stays linear
+	while (m_pausedFrames.size() <= frameNr) {
+		QV4::CppStackFrame* frame = m_pausedFrames.isEmpty() ? m_engine->currentStackFrame : parentFrame(m_pausedFrames.last());
+		if (!frame)
+			return nullptr;
+		m_pausedFrames.append(frame);
+	}
+	return m_pausedFrames[frameNr];
+}
+
+const SV4StackFrame& CV4DebugAgent::stackFrame(int frameNr, QV4::CppStackFrame* frame)
+{
+	// Note: m_mutex must be held and the engine paused, as we use the engine thread's script lookup here
+	auto I = m_stackFrames.find(frameNr);
+	if (I != m_stackFrames.end())
+		return *I;
+
+	const SUnitInfo& info = unitInfo(frame->v4Function);
+	SV4StackFrame& entry = m_stackFrames[frameNr];
+	entry.scriptId = info.scriptId;
+	entry.fileName = info.name;
+	entry.function = frame->function();
+	entry.lineNumber = qAbs(frame->lineNumber());
+	return entry;
+}
+
+QSet<qint64> CV4DebugAgent::getCurrentScripts()
+{
+	QMutexLocker locker(&m_mutex);
+	if (m_paused && !m_currentScriptsValid) {
+		m_currentScripts.clear();
+		for (qint64 scriptId : m_scriptIdStack) {
+			if (scriptId != -1)
+				m_currentScripts.insert(scriptId);
+		}
+		m_currentScriptsValid = true;
+	}
+	return m_currentScripts;
+}
+
 QV4::Heap::ExecutionContext* CV4DebugAgent::findContext(QV4::ExecutionEngine* engine, int frameNr)
 {
 	QV4::CppStackFrame* frame = findFrame(engine, frameNr);
@@ -206,10 +588,8 @@ int CV4DebugAgent::setBreakpoint(const SV4Breakpoint& Breakpoint)
 
 	int id = ++m_breakpointIdCtr;
 
-	SV4Breakpoint& bp = m_breakpoints[id];
-	bp = Breakpoint;
-	m_breakpointHash.insert(SBreakKey(bp.fileName, bp.lineNumber), &bp);
-	m_haveBreakpoints = true;
+	m_breakpoints[id] = Breakpoint;
+	publishBreakTable();
 
 	return id;
 }
@@ -218,9 +598,9 @@ void CV4DebugAgent::deleteBreakpoint(int id)
 {
 	QMutexLocker locker(&m_mutex);
 
-	SV4Breakpoint bp = m_breakpoints.take(id);
-	m_breakpointHash.remove(SBreakKey(bp.fileName, bp.lineNumber));
-	m_haveBreakpoints = !m_breakpoints.isEmpty();
+	dropCondition(id);
+	if (m_breakpoints.remove(id))
+		publishBreakTable();
 }
 
 void CV4DebugAgent::deleteAllBreakpoints()
@@ -228,8 +608,9 @@ void CV4DebugAgent::deleteAllBreakpoints()
 	QMutexLocker locker(&m_mutex);
 
 	m_breakpoints.clear();
-	m_breakpointHash.clear();
-	m_haveBreakpoints = false;
+	m_retiredConditions.append(m_conditions.values());
+	m_conditions.clear();
+	publishBreakTable();
 }
 
 bool CV4DebugAgent::updateBreakpoint(int id, const SV4Breakpoint& Breakpoint)
@@ -239,21 +620,92 @@ bool CV4DebugAgent::updateBreakpoint(int id, const SV4Breakpoint& Breakpoint)
 	auto I = m_breakpoints.find(id);
 	if (I == m_breakpoints.end())
 		return false;
-	m_breakpointHash.remove(SBreakKey(I->fileName, I->lineNumber));
-	*I = Breakpoint;
-	m_breakpointHash.insert(SBreakKey(I->fileName, I->lineNumber), &*I);
+	if (I->condition == Breakpoint.condition) { // keep the statistics of an unchanged condition
+		qint64 conditionTime = I->conditionTime;
+		*I = Breakpoint;
+		I->conditionTime = conditionTime;
+	} else {
+		dropCondition(id);
+		*I = Breakpoint;
+	}
+	publishBreakTable();
 	return true;
 }
 
-CV4DebugAgent::PauseReason CV4DebugAgent::checkBreakpoints(const QString& fileName, int lineNumber)
+const CV4DebugAgent::SUnitInfo& CV4DebugAgent::unitInfo(QV4::Function* function)
 {
-	auto I = m_breakpointHash.find(SBreakKey(QUrl(fileName).fileName(), lineNumber));
-	if (I == m_breakpointHash.end())
-		return DontBreak;
+	// Note: this is called by the engine thread only, the script identity is resolved once per compilation unit,
+	//	our copy of the unit's file name keeps its data alive, so sharing it identifies the unit without comparing
+	const void* unit = function->compilationUnit;
+	QString sourceFile = function->sourceFile();
+	if (m_lastUnit == unit && m_lastUnitInfo->sourceFile.isSharedWith(sourceFile))
+		return *m_lastUnitInfo;
+
+	SUnitInfo& info = m_units[unit];
+	if (!info.sourceFile.isSharedWith(sourceFile)) { // new unit, or a new unit reusing the address of a released one
+		info.sourceFile = sourceFile;
+		info.name = QUrl(sourceFile).fileName();
+		info.scriptId = m_scripts->getScriptId(info.name);
+	}
+	m_lastUnit = unit;
+	m_lastUnitInfo = &info;
+	return info;
+}
+
+const CV4DebugAgent::SScriptBreaks* CV4DebugAgent::resolveBreaks(QV4::Function* function)
+{
+	// Note: this is called by the engine thread only, the returned pointer stays valid until the engine 
+	//	thread resolves breaks from a newer table, only then the retired table may be freed
+	const SBreakTable* table = m_breakTable.loadAcquire();
+	if (!table) {
+		m_resolved = SResolvedBreaks();
+		return nullptr;
+	}
 
-	SV4Breakpoint* bp = *I;
-	if (bp == (SV4Breakpoint*)-1)
+	const void* unit = function->compilationUnit;
+	if (m_resolved.serial == table->serial && m_resolved.unit == unit)
+		return m_resolved.breaks;
+
+	auto I = table->scripts.find(unitInfo(function).name);
+	if (m_resolved.serial != table->serial) // breaks resolved from older tables are no longer referenced
+		m_readerSerial.storeRelease(table->serial);
+	m_resolved.serial = table->serial;
+	m_resolved.unit = unit;
+	m_resolved.breaks = I != table->scripts.end() ? &*I : nullptr;
+	return m_resolved.breaks;
+}
+
+void CV4DebugAgent::updateFrameState(QV4::Function* function)
+{
+	resolveBreaks(function);
+	m_frameState.serial = m_resolved.serial;
+	m_frameState.hasBreaks = m_resolved.breaks != nullptr;
+}
+
+bool CV4DebugAgent::checkAttached()
+{
+	// Note: this is called by the engine thread, while detached the hooks did not track the calls,
+	//	so when we get attached again the frame stacks are out of sync and must start over
+	bool attached = m_attached.loadRelaxed() != 0;
+	if (attached && !m_wasAttached) {
+		m_frameStateStack.clear();
+		m_frameState = SFrameState();
+		m_scriptIdStack.clear();
+	}
+	m_wasAttached = attached;
+	return attached;
+}
+
+CV4DebugAgent::PauseReason CV4DebugAgent::checkBreakpoints(const SScriptBreaks* breaks, int lineNumber)
+{
+	if (lineNumber == breaks->runUntilLine)
 		return LocationReached;
+
+	auto I = m_breakpoints.find(breaks->breakpoints.value(lineNumber));
+	if (I == m_breakpoints.end())
+		return DontBreak;
+
+	SV4Breakpoint* bp = &*I;
 	if (!bp->enabled)
 		return DontBreak;
 
@@ -261,10 +713,12 @@ CV4DebugAgent::PauseReason CV4DebugAgent::checkBreakpoints(const QString& fileNa
 		Q_ASSERT(m_runningJob == nullptr);
 
 		m_runningJob = (CV4DebugJob*)-1; // set dumy job to not enter maybeBreakAtInstruction
-		QV4::Scope scope(m_engine);
-		QV4::ScopedValue result = CV4ScriptJob::exec(m_engine, scope, bp->condition, -1/*, -1*/);
+		QElapsedTimer timer;
+		timer.start();
+		bool result = evaluateCondition(I.key(), bp->condition);
+		bp->conditionTime += timer.nsecsElapsed();
 		m_runningJob = nullptr;
-		if (!result->toBoolean())
+		if (!result)
 			return DontBreak;
 	}
 
@@ -273,8 +727,10 @@ CV4DebugAgent::PauseReason CV4DebugAgent::checkBreakpoints(const QString& fileNa
 		return DontBreak;
 	}
 
-	if (bp->singleShot)
+	if (bp->singleShot) {
 		bp->enabled = false;
+		publishBreakTable();
+	}
 
 	bp->hitCount++;
 	return BreakPointHit;
@@ -286,34 +742,36 @@ void CV4DebugAgent::signalAndWait(PauseReason reason)
 		return;
 	m_paused = true;
 
+	reclaimRetired();
+
 	// cleanup dummy breakpoints
 	clearRunUntil();
 
-	// capture stack trace for this break
-	// saves on computation if the caller accesses the trace one frame at a time
-	m_stackTrace = m_engine->stackTrace();
+	// only record the top frame, the rest of the stack is looked up when requested
+	m_pausedFrames.clear();
+	m_stackFrames.clear();
+	m_frameCount = -1;
+	m_currentScriptsValid = false;
 
 	// notify the debugger
-	if(m_engine->currentStackFrame)
-		emit debuggerPaused(this, reason, m_engine->currentStackFrame->v4Function->sourceFile(), m_engine->currentStackFrame->lineNumber());
-	else if(m_engine->globalCode)
-		emit debuggerPaused(this, reason, m_engine->globalCode->sourceFile(), 1);
+	if(m_engine->currentStackFrame) {
+		const SV4StackFrame& top = stackFrame(0, m_engine->currentStackFrame);
+		emit debuggerPaused(this, reason, top.scriptId, top.fileName, top.lineNumber);
+	}
+	else if(m_engine->globalCode) {
+		const SUnitInfo& info = unitInfo(m_engine->globalCode);
+		emit debuggerPaused(this, reason, info.scriptId, info.name, 1);
+	}
 	else
-		emit debuggerPaused(this, reason, QStringLiteral("unknown"), 1);
+		emit debuggerPaused(this, reason, -1, QString(), 1);
 
-	// wait and run jobs
+	// wait and run jobs, resume may be called while a job runs, so we remember it
+	m_resumed = false;
 	for (;;) {
-		m_engineWaiter.wait(&m_mutex);
-
-		if (!m_runningJob)
+		runQueuedJobs();
+		if (m_resumed)
 			break;
-		
-		//m_mutex.unlock();
-		m_runningJob->run();
-		//m_mutex.lock();
-
-		m_jobWaiter.wakeAll();
-		m_runningJob = nullptr;
+		m_engineWaiter.wait(&m_mutex);
 	}
 
 	m_paused = false;
@@ -325,28 +783,61 @@ void CV4DebugAgent::signalAndWait(PauseReason reason)
 
 bool CV4DebugAgent::pauseAtNextOpportunity() const
 {
-	return m_pauseRequested
-		|| m_haveBreakpoints
-		|| m_steppingMode >= StepOver;
+	if (!m_attached.loadRelaxed()) // dormant, run without per instruction callbacks
+		return false;
+
+	// queued jobs run at the next instruction
+	if (m_jobsPending.loadRelaxed())
+		return true;
+
+	// when stepping over or out, frames deeper than the one we step in run without callbacks
+	if (m_pauseRequested || isStepTarget())
+		return true;
+
+	// only frames of scripts with break locations need per instruction callbacks
+	if (m_frameState.hasBreaks)
+		return true;
+
+	// the breakpoints changed since the current frame was checked, let maybeBreakAtInstruction update it
+	const SBreakTable* table = m_breakTable.loadAcquire();
+	return (table ? table->serial : 0) != m_frameState.serial;
 }
 
 void CV4DebugAgent::maybeBreakAtInstruction()
 {
-	if (m_runningJob) // keep running when in job
+	if (m_runningJob || m_evaluating) // keep running when in job
+		return;
+
+	if (!checkAttached())
+		return;
+
+	if (m_jobsPending.loadAcquire()) {
+		QMutexLocker locker(&m_mutex);
+		runQueuedJobs(true);
+	}
+
+	// lock free fast path, unless we are stepping or a pause was requested only continue
+	// when the current line is set in the script's line bitmap
+	updateFrameState(m_engine->currentStackFrame->v4Function);
+	const SScriptBreaks* breaks = m_resolved.breaks;
+	int lineNumber = m_engine->currentStackFrame->lineNumber();
+	bool mayBreak = breaks && breaks->mayBreakAt(lineNumber);
+	if (mayBreak && !breaks->logpoints.isEmpty()) {
+		auto L = breaks->logpoints.find(lineNumber);
+		if (L != breaks->logpoints.end()) {
+			writeLog(*L, lineNumber);
+			mayBreak = lineNumber == breaks->runUntilLine || breaks->breakpoints.contains(lineNumber);
+		}
+	}
+	bool stepped = isStepTarget();
+	if (!mayBreak && !stepped && !m_pauseRequested)
 		return;
 
 	QMutexLocker locker(&m_mutex);
 
-	switch (m_steppingMode) {
-	case StepOver:
-		if (m_currentFrame != m_engine->currentStackFrame)
-			break;
-	case StepIn:
+	if (stepped) {
 		signalAndWait(Stepped);
 		return;
-	case StepOut:
-	case NotStepping:
-		break;
 	}
 
 	PauseReason pause = DontBreak;
@@ -354,41 +845,57 @@ void CV4DebugAgent::maybeBreakAtInstruction()
 		pause = m_pauseRequested;
 		m_pauseRequested = DontBreak;
 	}
-	else if (m_haveBreakpoints)
-		pause = checkBreakpoints(m_engine->currentStackFrame->v4Function->sourceFile(), m_engine->currentStackFrame->lineNumber());
+	else if (mayBreak)
+		pause = checkBreakpoints(breaks, lineNumber);
 	if (pause != DontBreak)
 		signalAndWait(pause);
 }
 
 void CV4DebugAgent::enteringFunction()
 {
-	if (m_runningJob)
+	if (m_runningJob || m_evaluating || !checkAttached())
 		return;
-	QMutexLocker locker(&m_mutex);
 
-	QString fileName = QUrl(m_engine->currentStackFrame->v4Function->sourceFile()).fileName();
-	m_scriptIdStack.append(fileName);
+	// function calls are safepoints as well, so jobs also run in code without per instruction callbacks
+	if (m_jobsPending.loadAcquire()) {
+		QMutexLocker locker(&m_mutex);
+		runQueuedJobs(true);
+	}
+
+	// decide once per frame whether it needs per instruction callbacks
+	QV4::Function* function = m_engine->currentStackFrame->v4Function;
+	m_frameStateStack.append(m_frameState);
+	updateFrameState(function);
+
+	// Note: the stepping state is only changed by the backend while the engine is paused, 
+	//	so we don't need to lock here
+	m_scriptIdStack.append(unitInfo(function).scriptId);
 
+	m_depth++;
 	if (m_steppingMode == StepIn)
-		m_currentFrame = m_engine->currentStackFrame;
+		m_stepDepth = m_depth;
 }
 
 void CV4DebugAgent::leavingFunction(const QV4::ReturnedValue& retVal)
 {
-	if (m_runningJob)
+	if (m_runningJob || m_evaluating || !checkAttached())
 		return;
-	QMutexLocker locker(&m_mutex);
 
-	m_scriptIdStack.removeLast();
+	// restore the callers state, if the breakpoints changed in the mean time pauseAtNextOpportunity will notice
+	if (!m_frameStateStack.isEmpty())
+		m_frameState = m_frameStateStack.takeLast();
+	else // the caller was entered before we got attached, let maybeBreakAtInstruction resolve it
+		m_frameState = SFrameState();
 
-	if (m_steppingMode != NotStepping && m_currentFrame == m_engine->currentStackFrame) {
-#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-		m_currentFrame = m_currentFrame->parent;
-#else
-		m_currentFrame = m_currentFrame->parentFrame();
-#endif
+	if (!m_scriptIdStack.isEmpty())
+		m_scriptIdStack.removeLast();
+
+	// when leaving the frame we step in, stop at the next instruction of the caller
+	if (m_steppingMode != NotStepping && m_depth == m_stepDepth) {
+		m_stepDepth--;
 		m_steppingMode = StepOver;
 	}
+	m_depth--;
 }
 
 void CV4DebugAgent::aboutToThrow()
@@ -396,7 +903,7 @@ void CV4DebugAgent::aboutToThrow()
 	if (!m_breakOnException)
 		return;
 
-	if (m_runningJob) // ignore exceptions in jobs
+	if (m_runningJob || m_evaluating) // ignore exceptions in jobs
 		return;
 
 	QMutexLocker locker(&m_mutex);
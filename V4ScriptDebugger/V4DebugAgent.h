@@ -33,8 +33,12 @@
 
 #include <QtCore/qmutex.h>
 #include <QtCore/qwaitcondition.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qbitarray.h>
+#include <QtCore/qsharedpointer.h>
 
 class CV4DebugJob;
+class CV4EngineItf;
 
 struct SV4Breakpoint {
 
@@ -49,6 +53,65 @@ struct SV4Breakpoint {
     QString condition;
     QVariant data;
     int hitCount;
+    qint64 conditionTime = 0; // total time spent evaluating the condition in nanoseconds
+    QString logMessage; // when set this is a logpoint, it logs the message at the line and never pauses
+    qint64 scriptId = -1; // set when the breakpoint was placed in a known script
+};
+
+struct SV4LogRecord {
+    qint64 timeStamp; // ms since epoch
+    qint64 scriptId;
+    int lineNumber;
+    QString message;
+};
+
+// bounded lock free queue with a single writer, the engine thread, and a single reader, the backend
+class CV4LogBuffer
+{
+public:
+    enum { Capacity = 1024 };
+
+    bool push(SV4LogRecord&& record) {
+        int head = m_head.loadRelaxed();
+        int next = (head + 1) % Capacity;
+        if (next == m_tail.loadAcquire()) { // full, drop the newest record
+            m_dropped.fetchAndAddRelaxed(1);
+            return false;
+        }
+        m_records[head] = std::move(record);
+        m_head.storeRelease(next);
+        return true;
+    }
+
+    bool pop(SV4LogRecord& record) {
+        int tail = m_tail.loadRelaxed();
+        if (tail == m_head.loadAcquire())
+            return false;
+        record = std::move(m_records[tail]);
+        m_tail.storeRelease((tail + 1) % Capacity);
+        return true;
+    }
+
+    int takeDropped() { return m_dropped.fetchAndStoreRelaxed(0); }
+
+    // true only for the first record written after the reader rearmed the buffer, so the reader is woken once per batch
+    bool needsWakeup() { return !m_signaled.fetchAndStoreAcquire(1); }
+    void rearm() { m_signaled.storeRelease(0); }
+
+private:
+    SV4LogRecord m_records[Capacity];
+    QAtomicInt m_head; // next slot to write
+    QAtomicInt m_tail; // next slot to read
+    QAtomicInt m_dropped;
+    QAtomicInt m_signaled;
+};
+
+struct SV4StackFrame {
+    qint64 scriptId = -1;
+    QString fileName;
+    QString function;
+    int lineNumber = -1;
+    int columnNumber = -1;
 };
 
 struct SV4Scope {
@@ -56,15 +119,39 @@ struct SV4Scope {
     QString type;
 };
 
+// a job queued for the engine thread, shared by the agent and the thread waiting for it
+struct SV4JobState {
+    enum EState {
+        eQueued = 0,
+        eRunning,
+        eFinished,
+        eCanceled
+    };
+
+    QSharedPointer<CV4DebugJob> job; // an abandoned job is freed once it returns
+    EState state = eQueued;
+    bool interrupted = false; // the job took too long and the engine was interrupted
+};
+
+typedef QSharedPointer<SV4JobState> CV4JobFuture;
+
 class CV4DebugAgent : public QV4::Debugging::Debugger
 {
     Q_OBJECT
 
 public:
-    CV4DebugAgent(QV4::ExecutionEngine* engine);
+    CV4DebugAgent(CV4EngineItf* engine);
+    ~CV4DebugAgent();
 
     QV4::ExecutionEngine* engine() const { return m_engine; }
 
+    // Note: installing the agent disables the JIT for the engine's remaining life, only newly compiled code carries debug instructions
+    void install();
+
+    // Note: the engine can not uninstall its debugger, so a detached agent stays installed and ignores all hooks
+    void setAttached(bool attached) { m_attached.storeRelease(attached ? 1 : 0); }
+    bool isAttached() const { return m_attached.loadAcquire() != 0; }
+
     enum Stepping {
         NotStepping = 0,
         StepOut,
@@ -87,10 +174,19 @@ public:
     void resume(Stepping stepping = NotStepping);
     void runUntil(const QString& fileName, int lineNumber);
 
-    QVector<QV4::StackFrame> stackTrace() const { return m_stackTrace; }
+    // the stack of the paused engine, frames are only looked up when requested
+    int frameCount();
+    QVector<SV4StackFrame> stackFrames(int from = 0, int count = -1);
     QVector<SV4Scope> getScopes(int frameNr);
 
-    void runJobInEngine(class CV4DebugJob* job, bool bWait = true);
+    enum { DefaultJobTimeout = 10000, CancelTimeout = 1000, JobRetryInterval = 50 }; // ms
+
+    // Note: jobs run in the engine thread, while paused right away, and when no script is executing from the event loop,
+    //  while running read only jobs also run at the next instruction or function call
+    CV4JobFuture scheduleJob(const QSharedPointer<CV4DebugJob>& job);
+    bool waitForJob(const CV4JobFuture& future, int timeoutMs = -1); // true when the job is done
+    bool cancelJob(const CV4JobFuture& future); // a running job is interrupted, returns false when it already finished
+    bool runJobInEngine(const QSharedPointer<CV4DebugJob>& job, int timeoutMs = DefaultJobTimeout); // false when the job was canceled
 
     void setBreakOnException(bool set = true) { m_breakOnException = set; }
     bool breakOnException() const { return m_breakOnException; }
@@ -101,21 +197,47 @@ public:
     void deleteAllBreakpoints();
     bool updateBreakpoint(int id, const SV4Breakpoint& Breakpoint);
 
-    struct SBreakKey {
-        SBreakKey(const QString& fileName, int lineNumber)
-            : fileName(fileName.mid(fileName.lastIndexOf('/') + 1)), lineNumber(lineNumber) {}
-        QString fileName;
-        int lineNumber;
+    // Note: only one thread may take the log records
+    bool takeLogRecord(SV4LogRecord& record) { return m_logBuffer.pop(record); }
+    int takeDroppedLogRecords() { return m_logBuffer.takeDropped(); }
+    void rearmLogRecords() { m_logBuffer.rearm(); } // call before draining, records written after it signal again
+
+    static QString scriptName(const QString& fileName) { return fileName.mid(fileName.lastIndexOf('/') + 1); }
+    static QString logProgram(const QString& message);
+
+    // break locations of one script
+    struct SScriptBreaks {
+        bool mayBreakAt(int lineNumber) const { return lineNumber >= 0 && lineNumber < lines.size() && lines.testBit(lineNumber); }
+
+        struct SLogPoint {
+            int id;
+            QString message;
+            QString program; // the message as a template literal
+        };
+
+        QBitArray lines; // lines with a break location
+        QHash<int, int> breakpoints; // line -> breakpoint id
+        QHash<int, SLogPoint> logpoints; // line -> logpoint
+        int runUntilLine = -1;
+    };
+
+    // immutable snapshot of the active break locations, read by the engine thread without locking
+    struct SBreakTable {
+        quint64 serial;
+        QHash<QString, SScriptBreaks> scripts;
     };
 
-    QSet<QString> getCurrentScripts() const { QMutexLocker locker(&m_mutex); return QSet<QString>(m_scriptIdStack.begin(), m_scriptIdStack.end()); }
+    // scripts which are on the stack of the paused engine, or were at the last pause
+    QSet<qint64> getCurrentScripts();
 
+    static QV4::CppStackFrame* parentFrame(QV4::CppStackFrame* frame);
     static QV4::CppStackFrame* findFrame(QV4::ExecutionEngine* engine, int frameNr);
     static QV4::Heap::ExecutionContext* findContext(QV4::ExecutionEngine* engine, int frameNr);
     static QV4::Heap::ExecutionContext* findScope(QV4::Heap::ExecutionContext* ctx, int scopeNr);
 
 signals:
-    void debuggerPaused(CV4DebugAgent* self, int reason, const QString& fileName, int lineNumber);
+    void debuggerPaused(CV4DebugAgent* self, int reason, qint64 scriptId, const QString& fileName, int lineNumber);
+    void logRecordsAvailable();
 
 private slots:
     void runJob();
@@ -127,32 +249,93 @@ protected:
     virtual void leavingFunction(const QV4::ReturnedValue& retVal) override;
     virtual void aboutToThrow() override;
 
-    PauseReason checkBreakpoints(const QString& fileName, int lineNumber);
+    bool checkAttached();
+    bool isStepTarget() const { return m_steppingMode == StepIn || (m_steppingMode == StepOver && m_depth <= m_stepDepth); }
+    PauseReason checkBreakpoints(const SScriptBreaks* breaks, int lineNumber);
     void clearRunUntil();
+    void publishBreakTable();
+    void reclaimRetiredTables();
+    void reclaimRetired();
+    bool evaluateCondition(int id, const QString& condition);
+    void dropCondition(int id);
+    void writeLog(const SScriptBreaks::SLogPoint& logpoint, int lineNumber);
+    struct SUnitInfo {
+        QString sourceFile;
+        QString name;
+        qint64 scriptId = -1;
+    };
+    const SUnitInfo& unitInfo(QV4::Function* function);
+    const SScriptBreaks* resolveBreaks(QV4::Function* function);
+    QV4::CppStackFrame* pausedFrame(int frameNr);
+    const SV4StackFrame& stackFrame(int frameNr, QV4::CppStackFrame* frame);
+    void updateFrameState(QV4::Function* function);
     void signalAndWait(PauseReason reason);
+    void runQueuedJobs(bool running = false);
 
     QV4::ExecutionEngine* m_engine;
+    CV4EngineItf* m_scripts;
+    QAtomicInt m_attached;
+    bool m_wasAttached; // only used by the engine thread
     bool m_breakOnException;
     PauseReason m_pauseRequested;
     bool m_paused;
-    QV4::CppStackFrame* m_currentFrame;
-    QVector<QV4::StackFrame> m_stackTrace;
+    bool m_resumed;
+    QVector<QV4::CppStackFrame*> m_pausedFrames; // frames walked since the last pause
+    QHash<int, SV4StackFrame> m_stackFrames; // frames looked up since the last pause
+    int m_frameCount;
     Stepping m_steppingMode;
+    int m_stepDepth; // depth of the frame we are stepping in
+    int m_depth; // current call depth, only changed by the engine thread
 
     // breakpoints
-    QHash<SBreakKey, SV4Breakpoint*> m_breakpointHash;
     QMap<int, SV4Breakpoint> m_breakpoints;
     int m_breakpointIdCtr;
-    bool m_haveBreakpoints;
+    QString m_runUntilFile;
+    int m_runUntilLine;
+    QAtomicPointer<SBreakTable> m_breakTable;
+    quint64 m_breakTableSerial;
+    QAtomicInteger<quint64> m_readerSerial; // serial of the table the engine thread last resolved breaks from
+    QList<SBreakTable*> m_retiredTables; // freed once the engine thread can no longer use them
+    QHash<int, class CV4CompiledScript*> m_conditions; // breakpoint id -> compiled condition
+    QList<class CV4CompiledScript*> m_retiredConditions; // must be freed by the engine thread
+
+    // logpoints, only written by the engine thread
+    QHash<int, class CV4CompiledScript*> m_logScripts; // breakpoint id -> compiled message
+    bool m_evaluating; // a logpoint message is being evaluated
+    CV4LogBuffer m_logBuffer;
+
+    // script identity per compilation unit, only used by the engine thread
+    QHash<const void*, SUnitInfo> m_units;
+    const void* m_lastUnit;
+    SUnitInfo* m_lastUnitInfo;
+
+    // break table lookup, only used by the engine thread
+    struct SResolvedBreaks {
+        quint64 serial = 0;
+        const void* unit = nullptr;
+        const SScriptBreaks* breaks = nullptr;
+    } m_resolved;
+
+    // per frame breakpoint interest, only used by the engine thread
+    struct SFrameState {
+        quint64 serial = 0; // break table the interest was resolved against
+        bool hasBreaks = false;
+    } m_frameState;
+    QVector<SFrameState> m_frameStateStack;
 
-    // script tracking
-    QList<QString> m_scriptIdStack;
+    // script tracking, the stack is only used by the engine thread
+    QVector<qint64> m_scriptIdStack;
+    QSet<qint64> m_currentScripts;
+    bool m_currentScriptsValid;
 
     // synchronization and jobs
     mutable QMutex m_mutex;
     QWaitCondition m_engineWaiter; // holds the engine untill the debugger resumes
-    QWaitCondition m_jobWaiter; // waits for the job to finish
-    CV4DebugJob* m_runningJob;
+    QWaitCondition m_jobWaiter; // waits for jobs to finish
+    QList<CV4JobFuture> m_jobQueue;
+    QAtomicInt m_jobsPending; // read only jobs are queued, checked by the engine thread without locking
+    CV4DebugJob* m_runningJob; // only used by the engine thread
+    bool m_jobRetryPending; // only used by the engine thread
 };
 
 #endif
\ No newline at end of file
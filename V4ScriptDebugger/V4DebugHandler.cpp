@@ -27,6 +27,9 @@
 #include <private/qv4objectiterator_p.h>
 #include <private/qv4runtime_p.h>
 #include <private/qv4identifiertable_p.h>
+#include <private/qv4typedarray_p.h>
+#include <private/qv4arraybuffer_p.h>
+#include <private/qv4qobjectwrapper_p.h>
 
 
 void SV4Value::fromVariant(const QVariantMap& in)
@@ -47,11 +50,18 @@ void SV4Value::fromVariant(const QVariantMap& in)
     else if (strType == "StringValue") {
         type = "string";
         data = in["value"];
+        if (in.contains("ref")) {
+            UV4Handle handle = { in["ref"].toULongLong() };
+            ref = handle.ref;
+            generation = handle.generation;
+            length = in["length"].toLongLong();
+        }
     }
     else if (strType == "ObjectValue") {
         type = "object";
         UV4Handle handle = { in["value"].toULongLong() };
         ref = handle.ref;
+        generation = handle.generation;
     }
 }
 
@@ -75,11 +85,20 @@ QVariantMap SV4Value::toVariant() const
     else if (type == "string") {
         value["type"] = "StringValue";
         value["value"] = data;
+        if (length >= 0 && ref != -1) { // only a prefix, the frontend fetches the rest by ref when asked to
+            UV4Handle handle = { 0 };
+            handle.type = UV4Handle::eValue;
+            handle.generation = generation;
+            handle.ref = ref;
+            value["ref"] = handle.value;
+            value["length"] = length;
+        }
     }
     else if (type == "object") {
         value["type"] = "ObjectValue";
         UV4Handle handle = { 0 };
         handle.type = UV4Handle::eObject;
+        handle.generation = generation;
         handle.ref = ref;
         value["value"] = handle.value;
     }
@@ -105,6 +124,25 @@ QVariantMap SV4Property::toVariant() const
     return out;
 }
 
+bool SV4Value::operator==(const SV4Value& other) const
+{
+    // everything the frontend shows of the value, an object's identity is its ref
+    return type == other.type && ref == other.ref && generation == other.generation && length == other.length
+        && data.toString() == other.data.toString();
+}
+
+QVariantMap SV4Binary::toVariant() const
+{
+    QVariantMap out;
+    out["elementType"] = elementType;
+    out["elementSize"] = elementSize;
+    out["length"] = length;
+    out["from"] = from;
+    out["bytes"] = bytes;
+    out["bigEndian"] = (Q_BYTE_ORDER == Q_BIG_ENDIAN);
+    return out;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4DebugHandler
 //
@@ -114,6 +152,8 @@ CV4DebugHandler::CV4DebugHandler(QV4::ExecutionEngine* engine, QObject* parent)
 {
     m_engine = engine;
     m_refArray.set(engine, engine->newArrayObject());
+    m_epoch = 1;
+    m_maxStringLength = DefaultMaxStringLength;
 }
 
 const QV4::Object* CV4DebugHandler::getValue(const QV4::ScopedValue& value, SV4Value* result)
@@ -128,21 +168,50 @@ const QV4::Object* CV4DebugHandler::getValue(const QV4::ScopedValue& value, SV4V
             result->data = qint64(arr->getLength());
             return arr;
         }
+        else if (const QV4::TypedArray* arr = value->as<QV4::TypedArray>()) {
+            result->data = QString("%1(%2)").arg(QLatin1String(arr->d()->type->name)).arg(arr->length());
+            return arr;
+        }
+        else if (const QV4::ArrayBuffer* buf = value->as<QV4::ArrayBuffer>()) {
+            result->data = QString("ArrayBuffer(%1)").arg(buf->d()->byteLength());
+            return buf;
+        }
+        else if (const QV4::QObjectWrapper* wrapper = value->as<QV4::QObjectWrapper>()) {
+            int count = getOwnPropertyNames(wrapper).size();
+            if (QObject* object = wrapper->object()) {
+                const SMetaCache& meta = getMetaCache(object->metaObject());
+                count += meta.properties.size();
+            }
+            if (count > MaxSummaryCount)
+                result->data = QString("%1+").arg(MaxSummaryCount);
+            else
+                result->data = count;
+            return wrapper;
+        }
         else if (const QV4::Object* obj = value->as<QV4::Object>()) {
             QV4::ObjectIterator it(scope, obj, QV4::ObjectIterator::EnumerableOnly);
             QV4::PropertyAttributes attrs;
             QV4::ScopedPropertyKey name(scope);
             int count = 0;
-            for (;; count++) {
+            for (; count <= MaxSummaryCount; count++) { // only count as much as we show
                 name = it.next(nullptr, &attrs);
                 if (!name->isValid())
                     break;
             }
-            result->data = count;
+            if (count > MaxSummaryCount)
+                result->data = QString("%1+").arg(MaxSummaryCount);
+            else
+                result->data = count;
             return obj;
         }
-        else if (const QV4::String* str = value->as<QV4::String>())
-            result->data = str->toQString();
+        else if (const QV4::String* str = value->as<QV4::String>()) {
+            QString text = str->toQString();
+            if (m_maxStringLength >= 0 && text.length() > m_maxStringLength) {
+                result->data = text.left(m_maxStringLength);
+                result->length = text.length();
+            } else
+                result->data = text;
+        }
         return nullptr;
     case QV4::Value::Boolean_Type:
         result->data = value->booleanValue();
@@ -160,85 +229,307 @@ const QV4::Object* CV4DebugHandler::getValue(const QV4::ScopedValue& value, SV4V
         return nullptr;
     }
 }
-QVector<SV4Property> CV4DebugHandler::getProperties(const QV4::Object* object)
+
+SV4Value CV4DebugHandler::getSummary(const QV4::ScopedValue& value)
+{
+    // the type and a short description of the value, objects are only enumerated when they get expanded
+    SV4Value result;
+    getValue(value, &result);
+    if (value->isManaged() && (!value->isString() || result.length >= 0)) { // truncated strings need a ref to fetch the rest
+        result.ref = addRef(value);
+        result.generation = m_refs[result.ref].generation;
+    }
+    return result;
+}
+
+QVector<SV4Property> CV4DebugHandler::getLocals(QV4::ExecutionContext* context)
+{
+    QV4::Scope scope(m_engine);
+    QV4::ScopedValue v(scope);
+    QV4::Heap::InternalClass* ic = context->internalClass();
+    QV4::Heap::CallContext* ctx = static_cast<QV4::Heap::CallContext*>(context->d());
+
+    SLocalsCache& cache = m_localsCache[ctx];
+    if (cache.internalClass != ic || cache.locals.size() != int(ic->size)) { // a new scope, or one which got new locals
+        cache.internalClass = ic;
+        cache.locals = QVector<SCachedLocal>(ic->size);
+        cache.context.set(m_engine, *context);
+        cache.values.set(m_engine, m_engine->newArrayObject(ic->size));
+    }
+    cache.epoch = m_epoch;
+    QV4::ScopedObject values(scope, cache.values.value());
+
+    QVector<SV4Property> locals;
+    locals.reserve(ic->size);
+    for (uint i = 0; i < ic->size; ++i) {
+        SCachedLocal& entry = cache.locals[i];
+        v = ctx->locals[i];
+        // only the summaries of immutable values are reused, an object changed in place keeps its value
+        if (!entry.valid || entry.value != v->rawValue() || v->isObject()) {
+            entry.property = SV4Property(getSummary(v), ic->keyAt(i));
+            entry.value = v->rawValue();
+            entry.valid = true;
+            values->put(i, v);
+        }
+        else if (entry.property.ref != -1) { // same value, but its ref may have been released since
+            entry.property.ref = addRef(v);
+            entry.property.generation = m_refs[entry.property.ref].generation;
+        }
+        locals.append(entry.property);
+    }
+    return locals;
+}
+
+QVector<SV4Property> CV4DebugHandler::getProperties(const QV4::Object* object, int from, int count, bool* hasMore)
 {
+    // returns count properties starting at from, a negative count returns all remaining properties
     QVector<SV4Property> properties;
+    if (hasMore)
+        *hasMore = false;
 
     QV4::Scope scope(m_engine);
+    QV4::ScopedValue value(scope);
+
+    // arrays are paged by index, so the elements before the requested range are not touched
+    if (const QV4::ArrayObject* arr = object->as<QV4::ArrayObject>()) {
+        qint64 length = arr->getLength();
+        qint64 end = count < 0 ? length : qMin<qint64>(length, qint64(from) + count);
+        for (qint64 i = from; i < end; i++) {
+            value = arr->get(uint(i));
+            properties.append(SV4Property(getSummary(value), QString::number(i)));
+        }
+        if (end < length) {
+            if (hasMore)
+                *hasMore = true;
+            return properties;
+        }
+
+        // the named properties follow the last element
+        QV4::ObjectIterator it(scope, object, QV4::ObjectIterator::EnumerableOnly);
+        QV4::PropertyAttributes attrs;
+        QV4::ScopedPropertyKey name(scope);
+        for (;;) {
+            name = it.next(nullptr, &attrs);
+            if (!name->isValid())
+                break;
+            if (name->isArrayIndex())
+                continue;
+            value = arr->get(name);
+            properties.append(SV4Property(getSummary(value), name->toQString()));
+        }
+        return properties;
+    }
+
+    // wrapped QObjects list their own properties first, followed by those of their class read directly through the meta object
+    if (const QV4::QObjectWrapper* wrapper = object->as<QV4::QObjectWrapper>()) {
+        int index = 0;
+        bool more = false;
+        auto take = [&]() { // whether the next property is in the requested range
+            int i = index++;
+            if (count >= 0 && i >= from + count)
+                more = true;
+            return i >= from && !more;
+        };
+
+        QV4::ScopedString name(scope);
+        for (const QString& ownName : getOwnPropertyNames(wrapper)) {
+            if (more)
+                break;
+            if (!take())
+                continue;
+            name = m_engine->newString(ownName);
+            value = wrapper->get(name);
+            properties.append(SV4Property(getSummary(value), ownName));
+        }
+
+        if (QObject* qobject = wrapper->object()) {
+            const QMetaObject* metaObject = qobject->metaObject();
+            const SMetaCache& meta = getMetaCache(metaObject);
+            for (int i = 0; i < meta.properties.size() && !more; i++) {
+                if (!take())
+                    continue;
+                value = m_engine->fromVariant(metaObject->property(meta.properties[i].second).read(qobject));
+                properties.append(SV4Property(getSummary(value), meta.properties[i].first));
+            }
+            for (int i = 0; i < meta.methods.size() && !more; i++) {
+                if (!take())
+                    continue;
+                SV4Property method; // shown as a function only, so the method object is not created
+                method.type = "function";
+                method.name = meta.methods[i];
+                properties.append(method);
+            }
+        }
+
+        if (hasMore)
+            *hasMore = more;
+        return properties;
+    }
+
     QV4::ObjectIterator it(scope, object, QV4::ObjectIterator::EnumerableOnly);
     QV4::ScopedValue name(scope);
-    QV4::ScopedValue value(scope);
-    for (;;) {
+    for (int i = 0;; i++) {
         QV4::Value v;
         name = it.nextPropertyNameAsString(&v);
         if (name->isNull())
             break;
+        if (i < from)
+            continue;
+        if (count >= 0 && i >= from + count) {
+            if (hasMore)
+                *hasMore = true;
+            break;
+        }
         value = v;
 
-        SV4Property result;
-        QString key = name->toQStringNoThrow();
-        if (!key.isNull())
-            result.name = key;
+        properties.append(SV4Property(getSummary(value), name->toQStringNoThrow()));
+    }
 
-        getValue(value, &result);
-        if (value->isManaged() && !value->isString())
-            result.ref = addRef(value);
+    return properties;
+}
 
-        properties.append(result);
+bool CV4DebugHandler::getBinary(const QV4::Object* object, qint64 from, qint64 count, SV4Binary* result)
+{
+    QV4::Scope scope(m_engine);
+    QV4::Scoped<QV4::ArrayBuffer> buffer(scope);
+    qint64 byteOffset = 0;
+    if (const QV4::TypedArray* arr = object->as<QV4::TypedArray>()) {
+        buffer = arr->d()->buffer;
+        byteOffset = arr->d()->byteOffset;
+        result->elementType = QLatin1String(arr->d()->type->name);
+        result->elementSize = arr->d()->type->bytesPerElement;
+        result->length = arr->length();
+    }
+    else if (const QV4::ArrayBuffer* buf = object->as<QV4::ArrayBuffer>()) {
+        buffer = buf->d();
+        result->elementType = QLatin1String("ArrayBuffer");
+        result->elementSize = 1;
+        result->length = buf->d()->byteLength();
     }
+    else
+        return false;
 
-    return properties;
+    // copy only the requested window straight out of the buffer, asByteArray would copy all of it first
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    const char* data = buffer->d()->data ? buffer->d()->data->data() : nullptr;
+#else
+    const char* data = buffer->constArrayData(); // null for a detached buffer
+#endif
+    // a stale or hostile range must not read past the buffer, which may also have been detached since
+    qint64 available = data ? (qint64(buffer->d()->byteLength()) - byteOffset) / result->elementSize : 0;
+    result->length = qBound<qint64>(0, available, result->length);
+    result->from = qBound<qint64>(0, from, result->length);
+    qint64 end = count < 0 || count > result->length - result->from ? result->length : result->from + count;
+    end = qMin(end, result->from + std::numeric_limits<int>::max() / result->elementSize); // a QByteArray holds less than 2 GB, the rest can be paged
+    if (end > result->from)
+        result->bytes = QByteArray(data + byteOffset + result->from * result->elementSize, qsizetype((end - result->from) * result->elementSize));
+    return true;
+}
+
+QStringList CV4DebugHandler::getOwnPropertyNames(const QV4::Object* object)
+{
+    // the properties set from script on the object itself, as found in its internal class
+    QStringList names;
+    QV4::Heap::InternalClass* ic = object->internalClass();
+    for (uint i = 0; i < ic->size; ++i) {
+        QString name = ic->keyAt(i);
+        if (!name.isEmpty()) // the second slot of an accessor has no name
+            names.append(name);
+    }
+    return names;
+}
+
+const CV4DebugHandler::SMetaCache& CV4DebugHandler::getMetaCache(const QMetaObject* metaObject)
+{
+    // a dynamic meta object may be freed and its address reused by another class, so check the entry still fits
+    auto I = m_metaCache.find(metaObject);
+    if (I != m_metaCache.end() && I->className == metaObject->className()
+        && I->propertyCount == metaObject->propertyCount() && I->methodCount == metaObject->methodCount())
+        return *I;
+
+    SMetaCache& meta = m_metaCache[metaObject];
+    meta = SMetaCache();
+    meta.className = metaObject->className();
+    meta.propertyCount = metaObject->propertyCount();
+    meta.methodCount = metaObject->methodCount();
+    QSet<QString> names;
+    for (int i = 0; i < metaObject->propertyCount(); i++) {
+        QString name = QString::fromLatin1(metaObject->property(i).name());
+        names.insert(name);
+        meta.properties.append(qMakePair(name, i));
+    }
+    for (int i = 0; i < metaObject->methodCount(); i++) {
+        QMetaMethod method = metaObject->method(i);
+        if (method.access() == QMetaMethod::Private)
+            continue;
+        QString name = QString::fromLatin1(method.name());
+        if (names.contains(name)) // overloads are listed once
+            continue;
+        names.insert(name);
+        meta.methods.append(name);
+    }
+    return meta;
 }
 
-SV4Object CV4DebugHandler::getObject(const QV4::ScopedValue& value, uint ref)
+SV4Object CV4DebugHandler::getObject(const QV4::ScopedValue& value, uint ref, int from, int count, bool binary)
 {
     SV4Object result;
 
     result.ref = ref;
+    if (ref < uint(m_refs.size()))
+        result.generation = m_refs[ref].generation;
     const QV4::Object* object = getValue(value, &result);
     if (object) {
         result.handle.type = UV4Handle::eObject;
-        result.properties = getProperties(object);
+        if (binary && getBinary(object, from, count, &result.binary)) // typed arrays are sent as raw bytes
+            result.hasMore = result.binary.from + result.binary.bytes.size() / result.binary.elementSize < result.binary.length;
+        else
+            result.properties = getProperties(object, from, count, &result.hasMore);
     } else
         result.handle.type = UV4Handle::eValue;
 
     return result;
 }
 
-SV4Object CV4DebugHandler::lookupRef(uint ref)
+SV4Object CV4DebugHandler::lookupRef(uint ref, int from, int count, bool binary)
 {
     QV4::Scope scope(m_engine);
     QV4::ScopedValue value(scope, getValue(ref));
 
-    return getObject(value, ref);
+    return getObject(value, ref, from, count, binary);
 }
 
-bool CV4DebugHandler::isValidRef(uint ref) const
+bool CV4DebugHandler::isValidRef(uint ref, uint generation) const
 {
-    QV4::Scope scope(m_engine);
-    QV4::ScopedObject refArray(scope, m_refArray.value());
-
-    return ref < refArray->getLength();
+    return ref < uint(m_refs.size()) && m_refs[ref].generation != 0 && m_refs[ref].generation == generation;
 }
 
 uint CV4DebugHandler::addRef(QV4::Value value)
 {
+    // find and return already existing object
+    auto I = m_refIndex.constFind(value.rawValue());
+    if (I != m_refIndex.constEnd())
+        return *I;
+
     QV4::Scope scope(m_engine);
     QV4::ScopedObject refArray(scope, m_refArray.value());
-    
-    // find and return already existing object
-    for (uint i = 0; i < refArray->getLength(); ++i) {
-        if (refArray->get(i) == value.rawValue())
-            return i;
-    }
  
     quint8 hadException = m_engine->hasException;
     m_engine->hasException = false; // ensure put works
 
-    // track new object
-    uint ref = refArray->getLength();
-    refArray->put(ref, value);
-    Q_ASSERT(refArray->getLength() - 1 == ref);
+    // track new object, reuse a released slot if there is one
+    uint ref;
+    if (!m_freeRefs.isEmpty()) {
+        ref = m_freeRefs.takeLast();
+        refArray->put(ref, value);
+    } else {
+        ref = refArray->getLength();
+        refArray->put(ref, value);
+        Q_ASSERT(refArray->getLength() - 1 == ref);
+        m_refs.append(SRef());
+    }
+    m_refs[ref] = SRef{ value.rawValue(), m_epoch, 0 };
+    m_refIndex.insert(value.rawValue(), ref);
 
     m_engine->hasException = hadException;
 
@@ -253,3 +544,62 @@ QV4::ReturnedValue CV4DebugHandler::getValue(uint ref)
     Q_ASSERT(ref < refArray->getLength());
     return refArray->get(ref, nullptr);
 }
+
+void CV4DebugHandler::pinRef(uint ref, uint generation, int pins)
+{
+    if (isValidRef(ref, generation)) // a result abandoned after it got pinned may leave a pin behind, but never a negative count
+        m_refs[ref].pins = qMax(0, m_refs[ref].pins + pins);
+}
+
+void CV4DebugHandler::pinRefs(const SV4Object& object)
+{
+    if (object.handle.type == UV4Handle::eObject)
+        pinRef(object.handle.ref, object.handle.generation, 1);
+    for (const SV4Property& property : object.properties) {
+        if (property.ref != -1)
+            pinRef(property.ref, property.generation, 1);
+    }
+}
+
+void CV4DebugHandler::unpinRefs(const SV4Object& object)
+{
+    if (object.handle.type == UV4Handle::eObject)
+        pinRef(object.handle.ref, object.handle.generation, -1);
+    for (const SV4Property& property : object.properties) {
+        if (property.ref != -1)
+            pinRef(property.ref, property.generation, -1);
+    }
+}
+
+void CV4DebugHandler::releaseRefs()
+{
+    // drop all refs which are not pinned, so the garbage collector can reclaim what was looked at during the last pause,
+    // the freed slots get a new generation when reused, so handles the frontend still holds are rejected
+    QV4::Scope scope(m_engine);
+    QV4::ScopedObject refArray(scope, m_refArray.value());
+
+    quint8 hadException = m_engine->hasException;
+    m_engine->hasException = false; // ensure put works
+
+    for (uint ref = 0; ref < uint(m_refs.size()); ref++) {
+        SRef& entry = m_refs[ref];
+        if (entry.generation == 0 || entry.pins > 0)
+            continue;
+        m_refIndex.remove(entry.value);
+        refArray->put(ref, QV4::Value::undefinedValue());
+        entry = SRef{ 0, 0, 0 };
+        m_freeRefs.append(ref);
+    }
+
+    m_engine->hasException = hadException;
+
+    for (auto I = m_localsCache.begin(); I != m_localsCache.end();) {
+        if (I->epoch != m_epoch)
+            I = m_localsCache.erase(I);
+        else
+            ++I;
+    }
+
+    if (++m_epoch > UV4Handle::eMaxGeneration)
+        m_epoch = 1;
+}
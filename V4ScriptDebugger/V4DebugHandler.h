@@ -24,6 +24,9 @@
 #define CV4DEBUGHANDLER_H
 
 #include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QMetaObject>
 
 #include <private/qv4engine_p.h>
 #include <private/qv4persistent_p.h>
@@ -38,10 +41,13 @@ union UV4Handle
 		eObject,
 		eThis
 	};
+	enum {
+		eMaxGeneration = 0xFFFFFF
+	};
 	struct {
 		quint32					// 32
 			type : 8,
-			unused : 24;
+			generation : 24;	// pause epoch the ref was created in, stale refs are rejected
 		union {
 			struct {
 				short frame;	// 16
@@ -54,14 +60,19 @@ union UV4Handle
 
 struct SV4Value
 {
-	SV4Value() : ref(-1) {}
+	SV4Value() : ref(-1), generation(0), length(-1) {}
 
 	void fromVariant(const QVariantMap& in);
     QVariantMap toVariant() const;
 
+	bool operator==(const SV4Value& other) const;
+	bool operator!=(const SV4Value& other) const { return !(*this == other); }
+
 	QString type;
 	QVariant data;
 	int ref;
+	uint generation;
+	qint64 length;	// the full length of a string of which data holds only a prefix, -1 otherwise
 };
 
 struct SV4Property : SV4Value
@@ -76,19 +87,41 @@ struct SV4Property : SV4Value
 	QString name;
 };
 
+// a range of the elements of a typed array or ArrayBuffer, sent as raw bytes for the frontend to decode
+struct SV4Binary
+{
+	SV4Binary() : elementSize(0), length(0), from(0) {}
+
+	bool isValid() const { return elementSize > 0; }
+	QVariantMap toVariant() const;
+
+	QString		elementType;	// the typed array's name, or ArrayBuffer
+	int			elementSize;
+	qint64		length;			// in elements
+	qint64		from;
+	QByteArray	bytes;			// in the engine's byte order
+};
+
 struct SV4Object: SV4Value
 {
-	SV4Object() : handle{ 0 } {}
+	SV4Object() : handle{ 0 }, hasMore(false) {}
 
 	UV4Handle			handle;
 	QVector<SV4Property>properties;
+	bool				hasMore;	// only a range of the properties was retrieved
+	SV4Binary			binary;		// the elements of a binary object, instead of properties
+};
+
+struct SV4ObjectSnapshot : SV4Object
+{
+	QHash<QString, SV4Value> values; // name -> the value last sent to the frontend
 };
 
 struct SV4ValueIterator
 {
-	SV4ValueIterator() : index(0) {}
+	SV4ValueIterator() : handle{ 0 }, index(0) {}
 
-	SV4Object	snapshot;
+	UV4Handle	handle;
 	int					index;
 };
 
@@ -105,21 +138,77 @@ public:
 
     QV4::ExecutionEngine* engine() const { return m_engine; }
 
+	// longer strings are sent as a prefix with a ref, the rest is fetched on request
+	enum { DefaultMaxStringLength = 10000 };
+	void setMaxStringLength(int length) { m_maxStringLength = length; }
+	int maxStringLength() const { return m_maxStringLength; }
+
 	uint addRef(QV4::Value value);
 	QV4::ReturnedValue getValue(uint ref);
 
-    bool isValidRef(uint ref) const;
-	SV4Object lookupRef(uint ref);
+    bool isValidRef(uint ref, uint generation) const;
+	SV4Object lookupRef(uint ref, int from = 0, int count = -1, bool binary = false);
+
+	// refs only live until the engine resumes, unless the frontend pins them, e.g. for expanded objects,
+	// like all ref bookkeeping pinning must be done from the engine thread
+	void pinRefs(const SV4Object& object);
+	void unpinRefs(const SV4Object& object);
+	void releaseRefs(); // must be called from the engine thread
 
 protected:
 	friend class CV4GetPropsJob;
+	friend class CV4GetExceptionJob;
+	enum { MaxSummaryCount = 1000 }; // objects with more properties are summarized as "1000+"
 	const QV4::Object* getValue(const QV4::ScopedValue& value, SV4Value* result);
-	QVector<SV4Property> getProperties(const QV4::Object* object);
-	SV4Object getObject(const QV4::ScopedValue& value, uint ref);
+	SV4Value getSummary(const QV4::ScopedValue& value);
+	QVector<SV4Property> getLocals(QV4::ExecutionContext* context);
+	QVector<SV4Property> getProperties(const QV4::Object* object, int from = 0, int count = -1, bool* hasMore = nullptr);
+	SV4Object getObject(const QV4::ScopedValue& value, uint ref, int from = 0, int count = -1, bool binary = false);
+	bool getBinary(const QV4::Object* object, qint64 from, qint64 count, SV4Binary* result);
+	QStringList getOwnPropertyNames(const QV4::Object* object);
 
 private:
     QV4::ExecutionEngine* m_engine;
     QV4::PersistentValue m_refArray;
+    QHash<quint64, uint> m_refIndex; // raw value -> ref, the referenced objects are kept alive by m_refArray so their address stays unique
+    struct SRef {
+        quint64 value;
+        uint generation; // 0 when the slot is free
+        int pins;
+    };
+    QVector<SRef> m_refs;
+    QVector<uint> m_freeRefs;
+    uint m_epoch;
+    int m_maxStringLength;
+
+    void pinRef(uint ref, uint generation, int pins);
+
+    // the locals last sent for each scope, while stepping only the slots whose value changed or holds an object are looked at again,
+    // the scope and the cached values are kept alive, so the garbage collector can not hand their addresses to new ones
+    struct SCachedLocal {
+        quint64 value = 0;
+        bool valid = false;
+        SV4Property property;
+    };
+    struct SLocalsCache {
+        QV4::PersistentValue context;
+        QV4::PersistentValue values;
+        const void* internalClass = nullptr;
+        uint epoch = 0; // entries not used during a pause are dropped when the engine resumes
+        QVector<SCachedLocal> locals;
+    };
+    QHash<const void*, SLocalsCache> m_localsCache;
+
+    // the properties and methods of a QObject class, so wrapped QObjects are listed without introspecting each instance
+    struct SMetaCache {
+        QByteArray className;
+        int propertyCount = 0;
+        int methodCount = 0;
+        QVector<QPair<QString, int>> properties; // name, property index
+        QStringList methods;
+    };
+    QHash<const QMetaObject*, SMetaCache> m_metaCache; // kept for the handler's life, most meta objects are static
+    const SMetaCache& getMetaCache(const QMetaObject* metaObject);
 };
 
 #endif
\ No newline at end of file
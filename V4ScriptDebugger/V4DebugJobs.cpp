@@ -32,14 +32,16 @@
 #include <private/qqmldebugservice_p.h>
 #include <private/qv4jscall_p.h>
 #include <private/qv4objectiterator_p.h>
+#include <private/qv4string_p.h>
+#include <private/qv4runtime_p.h>
 
 
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4ScopeJob
 //
 
-CV4GetPropsJob::CV4GetPropsJob(CV4DebugHandler* handler, UV4Handle handle) :
-    handler(handler), handle(handle), success(false)
+CV4GetPropsJob::CV4GetPropsJob(CV4DebugHandler* handler, UV4Handle handle, int from, int count, bool binary) :
+    handler(handler), handle(handle), from(from), count(count), binary(binary), success(false), pin(false)
 {
 }
 
@@ -49,8 +51,8 @@ void CV4GetPropsJob::run()
 
     if (handle.type == UV4Handle::eObject)
     {
-        if (handler->isValidRef(handle.ref)) {
-            result = handler->lookupRef(handle.ref);
+        if (handler->isValidRef(handle.ref, handle.generation)) {
+            result = handler->lookupRef(handle.ref, from, count, binary);
             success = true;
         }
     }
@@ -58,14 +60,7 @@ void CV4GetPropsJob::run()
     {
         QV4::Scoped<QV4::ExecutionContext> ctxt(scope, CV4DebugAgent::findScope(CV4DebugAgent::findContext(handler->engine(), handle.frame), handle.scope));
         if (ctxt) {
-            QV4::ScopedValue v(scope);
-            QV4::Heap::InternalClass* ic = ctxt->internalClass();
-            for (uint i = 0; i < ic->size; ++i) {
-                QString name = ic->keyAt(i);
-                v = static_cast<QV4::Heap::CallContext*>(ctxt->d())->locals[i];
-                uint ref = handler->addRef(v);
-                result.properties.append(SV4Property(handler->getObject(v, ref), name));
-            }
+            result.properties = handler->getLocals(ctxt.getPointer());
             success = true;
         }
     }
@@ -76,8 +71,41 @@ void CV4GetPropsJob::run()
             QV4::ScopedValue v(scope, frame->thisObject());
             uint ref = handler->addRef(v);
             result = handler->getObject(v, ref);
+            success = true;
         }
     }
+
+    if (success && pin) {
+        result.handle = handle;
+        handler->pinRefs(result);
+        handler->unpinRefs(unpin);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4GetStringJob
+//
+
+CV4GetStringJob::CV4GetStringJob(CV4DebugHandler* handler, UV4Handle handle, int from, int count) :
+    handler(handler), handle(handle), from(from), count(count), success(false), stale(false), length(0)
+{
+}
+
+void CV4GetStringJob::run()
+{
+    QV4::Scope scope(handler->engine());
+
+    if (!handler->isValidRef(handle.ref, handle.generation)) {
+        stale = true;
+        return;
+    }
+    QV4::ScopedValue v(scope, handler->getValue(handle.ref));
+    if (const QV4::String* str = v->as<QV4::String>()) {
+        QString text = str->toQString();
+        length = text.length();
+        result = text.mid(from, count);
+        success = true;
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////
@@ -104,11 +132,16 @@ void CV4SetValueJob::run()
         v = QV4::Encode(value.data.toDouble());
     else if (value.type == "string") 
         v = handler->engine()->newString(value.data.toString());
-    else if (value.ref != -1)
+    else if (value.ref != -1) {
+        if (!handler->isValidRef(value.ref, value.generation))
+            return;
         v = handler->getValue(value.ref);
+    }
         
     if (handle.type == UV4Handle::eObject)
     {
+        if (!handler->isValidRef(handle.ref, handle.generation))
+            return;
         QV4::ScopedObject o(scope, handler->getValue(handle.ref));
         if (o->as<QV4::ArrayObject>() != NULL) {
             o->put(name.toInt(), v);
@@ -132,6 +165,56 @@ void CV4SetValueJob::run()
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+// CV4GetExceptionJob
+//
+
+void CV4GetExceptionJob::run()
+{
+    QV4::ExecutionEngine* engine = handler->engine();
+    QV4::Scope scope(engine);
+    QV4::ScopedValue ex(scope, engine->exceptionValue->asReturnedValue());
+
+    // the conversion may run script code, which must not disturb the pending exception
+    quint8 hadException = engine->hasException;
+    engine->hasException = false;
+    QV4::ScopedValue prim(scope, QV4::RuntimeHelpers::toPrimitive(ex->asReturnedValue(), QV4::STRING_HINT));
+    engine->hasException = hadException;
+    *engine->exceptionValue = ex->asReturnedValue();
+    if (prim->isPrimitive())
+        message = prim->toQStringNoThrow();
+
+    // objects are only summarized, their properties are retrieved when the frontend expands them
+    result = handler->getSummary(ex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4ReleaseRefsJob
+//
+
+void CV4ReleaseRefsJob::run()
+{
+    handler->releaseRefs();
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4UnpinRefsJob
+//
+
+void CV4UnpinRefsJob::run()
+{
+    handler->unpinRefs(object);
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4DeleteHandlerJob
+//
+
+void CV4DeleteHandlerJob::run()
+{
+    delete handler;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4ScriptJob
 //
@@ -180,6 +263,44 @@ QV4::ScopedValue CV4ScriptJob::exec(QV4::ExecutionEngine* engine, QV4::Scope& sc
     return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+// CV4CompiledScript
+//
+
+CV4CompiledScript::CV4CompiledScript(QV4::ExecutionEngine* engine, const QString& program, bool strictMode) :
+    program(program), strictMode(strictMode)
+{
+    QV4::Scope scope(engine);
+    QV4::ScopedContext ctx(scope, engine->currentContext());
+
+    // Note: eval code resolves names at runtime, so once compiled it can be run in the context of any frame
+    script = new QV4::Script(ctx, QV4::Compiler::ContextType::Eval, program);
+    script->strictMode = strictMode;
+    script->inheritContext = true;
+    script->parse();
+    if (engine->hasException)
+        engine->catchException();
+}
+
+CV4CompiledScript::~CV4CompiledScript()
+{
+    delete script;
+}
+
+bool CV4CompiledScript::isValid() const
+{
+    return script->vmFunction != nullptr;
+}
+
+QV4::ReturnedValue CV4CompiledScript::run(QV4::ExecutionEngine* engine)
+{
+    // Note: the caller must check isValid and handle exceptions
+    QV4::Scope scope(engine);
+    QV4::ScopedContext ctx(scope, engine->currentContext());
+    QV4::ScopedValue thisObject(scope, engine->currentStackFrame->thisObject());
+    return script->vmFunction->call(thisObject, nullptr, 0, ctx);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4RunScriptJob
 //
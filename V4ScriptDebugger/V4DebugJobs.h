@@ -25,6 +25,8 @@
 
 #include "V4DebugHandler.h"
 
+namespace QV4 { struct Script; }
+
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4DebugJob
 //
@@ -35,6 +37,10 @@ public:
     virtual ~CV4DebugJob() {}
 
     virtual void run() = 0;
+
+    // only jobs which merely read the script's state may run while the engine executes script,
+    // all others wait until the engine is paused or idle
+    virtual bool isReadOnly() const { return false; }
 };
 
 ////////////////////////////////////////////////////////////////////////////////////
@@ -45,17 +51,51 @@ class CV4GetPropsJob : public CV4DebugJob
 {
     class CV4DebugHandler* handler;
     UV4Handle handle;
+    int from;
+    int count;
+    bool binary;
     bool success;
     SV4Object result;
+    bool pin;
+    SV4Object unpin;
 
 public:
-    CV4GetPropsJob(CV4DebugHandler* handler, UV4Handle handle);
-    void run() override;
+    CV4GetPropsJob(CV4DebugHandler* handler, UV4Handle handle, int from = 0, int count = -1, bool binary = false);
+    void run() override; // not read only, it adds refs and property getters run script
+
+    // pin the refs of the result and unpin those of the previous one, for a result the frontend holds on to
+    void setPinned(const SV4Object& previous) { pin = true; unpin = previous; }
 
     bool wasSuccessful() const { return success; }
     const SV4Object& returnValue() const { return result; }
 };
 
+////////////////////////////////////////////////////////////////////////////////////
+// CV4GetStringJob
+//
+
+class CV4GetStringJob : public CV4DebugJob
+{
+    class CV4DebugHandler* handler;
+    UV4Handle handle;
+    int from;
+    int count;
+    bool success;
+    bool stale;
+    QString result;
+    qint64 length;
+
+public:
+    CV4GetStringJob(CV4DebugHandler* handler, UV4Handle handle, int from = 0, int count = -1);
+    void run() override;
+    bool isReadOnly() const override { return true; }
+
+    bool wasSuccessful() const { return success; }
+    bool isStale() const { return stale; } // the ref was released since
+    const QString& returnValue() const { return result; }
+    qint64 stringLength() const { return length; }
+};
+
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4SetValueJob
 //
@@ -75,6 +115,64 @@ public:
     bool wasSuccessful() const { return success; }
 };
 
+////////////////////////////////////////////////////////////////////////////////////
+// CV4GetExceptionJob
+//
+
+class CV4GetExceptionJob : public CV4DebugJob
+{
+    class CV4DebugHandler* handler;
+    QString message;
+    SV4Value result;
+
+public:
+    CV4GetExceptionJob(CV4DebugHandler* handler) : handler(handler) {}
+    void run() override;
+
+    const QString& exceptionMessage() const { return message; }
+    const SV4Value& returnValue() const { return result; }
+};
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4ReleaseRefsJob
+//
+
+class CV4ReleaseRefsJob : public CV4DebugJob
+{
+    class CV4DebugHandler* handler;
+
+public:
+    CV4ReleaseRefsJob(CV4DebugHandler* handler) : handler(handler) {}
+    void run() override;
+};
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4UnpinRefsJob
+//
+
+class CV4UnpinRefsJob : public CV4DebugJob
+{
+    class CV4DebugHandler* handler;
+    SV4Object object;
+
+public:
+    CV4UnpinRefsJob(CV4DebugHandler* handler, const SV4Object& object) : handler(handler), object(object) {}
+    void run() override;
+};
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4DeleteHandlerJob
+//
+
+class CV4DeleteHandlerJob : public CV4DebugJob
+{
+    class CV4DebugHandler* handler;
+
+public:
+    CV4DeleteHandlerJob(CV4DebugHandler* handler) : handler(handler) {}
+    void run() override;
+};
+
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4ScriptJob
 //
@@ -84,7 +182,7 @@ class CV4ScriptJob : public CV4DebugJob
     QV4::ExecutionEngine* engine;
     int frameNr;
     //int context;
-    const QString& program;
+    QString program;
     bool resultIsException;
 
 public:
@@ -100,6 +198,26 @@ protected:
     virtual void handleResult(QV4::ScopedValue& result) = 0;
 };
 
+////////////////////////////////////////////////////////////////////////////////////
+// CV4CompiledScript
+//
+
+class CV4CompiledScript
+{
+    QString program;
+    bool strictMode;
+    QV4::Script* script;
+
+public:
+    CV4CompiledScript(QV4::ExecutionEngine* engine, const QString& program, bool strictMode);
+    ~CV4CompiledScript();
+
+    bool isCompiledFor(const QString& program, bool strictMode) const { return this->program == program && this->strictMode == strictMode; }
+    bool isValid() const;
+
+    QV4::ReturnedValue run(QV4::ExecutionEngine* engine);
+};
+
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4RunScriptJob
 //
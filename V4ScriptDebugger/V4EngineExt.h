@@ -43,10 +43,10 @@ public:
     Q_INVOKABLE QJSValue evaluateScript(const QString& program, const QString& fileName, int lineNumber = 1);
 
     int getScriptCount() const { return m_Scripts.count(); }
-    QString getScriptName(qint64 scriptId) const { if (scriptId < m_Scripts.size()) return m_Scripts[scriptId].Name; return QString(); }
-    QString getScriptSource(qint64 scriptId) const { if (scriptId < m_Scripts.size()) return m_Scripts[scriptId].Source; return QString(); }
-    int getScriptLineNumber(qint64 scriptId) const { if (scriptId < m_Scripts.size()) return m_Scripts[scriptId].LineNumber; return -1; }
-    qint64 getScriptId(const QString& fileName) const { return m_ScriptIDs.value(fileName.toLower()); }
+    QString getScriptName(qint64 scriptId) const { if (scriptId >= 0 && scriptId < m_Scripts.size()) return m_Scripts[scriptId].Name; return QString(); }
+    QString getScriptSource(qint64 scriptId) const { if (scriptId >= 0 && scriptId < m_Scripts.size()) return m_Scripts[scriptId].Source; return QString(); }
+    int getScriptLineNumber(qint64 scriptId) const { if (scriptId >= 0 && scriptId < m_Scripts.size()) return m_Scripts[scriptId].LineNumber; return -1; }
+    qint64 getScriptId(const QString& fileName) const { return m_ScriptIDs.value(fileName.toLower(), -1); }
 
     QString trackScript(const QString& program, const QString& fileName, int lineNumber = 1);
 
@@ -38,7 +38,7 @@ public:
     virtual QString getScriptName(qint64 scriptId) const = 0;
     virtual QString getScriptSource(qint64 scriptId) const = 0;
     virtual int getScriptLineNumber(qint64 scriptId) const = 0;
-    virtual qint64 getScriptId(const QString& fileName) const = 0;
+    virtual qint64 getScriptId(const QString& fileName) const = 0; // -1 if the script is not known
 
     //
     // Note: the implementation of this interface must be derived from 
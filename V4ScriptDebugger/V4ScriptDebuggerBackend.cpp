@@ -29,6 +29,9 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonValue>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QQueue>
 
 #include <private/qv4engine_p.h>
 #include <private/qv4debugging_p.h>
@@ -44,25 +47,224 @@
 
 #include "V4ScriptDebuggerApi.h"
 
+struct SV4Command {
+	enum EType {
+		eUnknown = 0,
+		eInterrupt,
+		eContinue,
+		eStepInto,
+		eStepOver,
+		eStepOut,
+		eResume,
+		eRunToLocation,
+		eRunToLocationByID,
+		eEvaluate,
+		eForceReturn,
+		eSetBreakpoint,
+		eDeleteBreakpoint,
+		eDeleteAllBreakpoints,
+		eGetBreakpoints,
+		eGetBreakpointData,
+		eSetBreakpointData,
+		eGetScriptData,
+		eResolveScript,
+		eGetScripts,
+		eScriptsCheckpoint,
+		eGetScriptsDelta,
+		eGetBacktrace,
+		eGetContextCount,
+		eGetContextInfo,
+		eGetContextState,
+		eGetContextID,
+		eContextsCheckpoint,
+		eGetThisObject,
+		eGetScopeChain,
+		eGetActivationObject,
+		eGetPropertyExpressionValue,
+		eGetCompletions,
+		eNewScriptObjectSnapshot,
+		eScriptObjectSnapshotCapture,
+		eScriptValueToString,
+		eGetStringRange,
+		eNewScriptValueIterator,
+		eDeleteScriptObjectSnapshot,
+		eGetPropertiesByIterator,
+		eDeleteScriptValueIterator,
+		eSetScriptValueProperty,
+		eClearExceptions,
+		eCount
+	};
+
+	static const QHash<QString, EType>& types()
+	{
+		static const QHash<QString, EType> Types = {
+			{"Interrupt", eInterrupt},
+			{"Continue", eContinue},
+			{"StepInto", eStepInto},
+			{"StepOver", eStepOver},
+			{"StepOut", eStepOut},
+			{"Resume", eResume},
+			{"RunToLocation", eRunToLocation},
+			{"RunToLocationByID", eRunToLocationByID},
+			{"Evaluate", eEvaluate},
+			{"ForceReturn", eForceReturn},
+			{"SetBreakpoint", eSetBreakpoint},
+			{"DeleteBreakpoint", eDeleteBreakpoint},
+			{"DeleteAllBreakpoints", eDeleteAllBreakpoints},
+			{"GetBreakpoints", eGetBreakpoints},
+			{"GetBreakpointData", eGetBreakpointData},
+			{"SetBreakpointData", eSetBreakpointData},
+			{"GetScriptData", eGetScriptData},
+			{"ResolveScript", eResolveScript},
+			{"GetScripts", eGetScripts},
+			{"ScriptsCheckpoint", eScriptsCheckpoint},
+			{"GetScriptsDelta", eGetScriptsDelta},
+			{"GetBacktrace", eGetBacktrace},
+			{"GetContextCount", eGetContextCount},
+			{"GetContextInfo", eGetContextInfo},
+			{"GetContextState", eGetContextState},
+			{"GetContextID", eGetContextID},
+			{"ContextsCheckpoint", eContextsCheckpoint},
+			{"GetThisObject", eGetThisObject},
+			{"GetScopeChain", eGetScopeChain},
+			{"GetActivationObject", eGetActivationObject},
+			{"GetPropertyExpressionValue", eGetPropertyExpressionValue},
+			{"GetCompletions", eGetCompletions},
+			{"NewScriptObjectSnapshot", eNewScriptObjectSnapshot},
+			{"ScriptObjectSnapshotCapture", eScriptObjectSnapshotCapture},
+			{"ScriptValueToString", eScriptValueToString},
+			{"GetStringRange", eGetStringRange},
+			{"NewScriptValueIterator", eNewScriptValueIterator},
+			{"DeleteScriptObjectSnapshot", eDeleteScriptObjectSnapshot},
+			{"GetPropertiesByIterator", eGetPropertiesByIterator},
+			{"DeleteScriptValueIterator", eDeleteScriptValueIterator},
+			{"SetScriptValueProperty", eSetScriptValueProperty},
+			{"ClearExceptions", eClearExceptions}
+		};
+		return Types;
+	}
+
+	static EType fromString(const QString& typeStr)
+	{
+		return types().value(typeStr, eUnknown);
+	}
+
+	static QString toString(EType type)
+	{
+		static const QVector<QString> Names = []() {
+			QVector<QString> Names(eCount);
+			for (auto I = types().constBegin(); I != types().constEnd(); ++I)
+				Names[I.value()] = I.key();
+			return Names;
+		}();
+		return Names.value(type);
+	}
+};
+
+// Note: commands may be run from more than one thread, so the stats are recorded without a lock,
+//	a reader may see a command which is only half recorded
+struct SV4CommandStats {
+	QAtomicInteger<quint64> count;
+	QAtomicInteger<qint64> totalTime; // ns
+	QAtomicInteger<qint64> maxTime; // ns
+
+	void record(qint64 elapsed)
+	{
+		count.fetchAndAddRelaxed(1);
+		totalTime.fetchAndAddRelaxed(elapsed);
+		qint64 max = maxTime.loadRelaxed();
+		while (elapsed > max && !maxTime.testAndSetRelaxed(max, elapsed, max))
+			; // max got the current value, try again
+	}
+
+	void reset()
+	{
+		count.storeRelaxed(0);
+		totalTime.storeRelaxed(0);
+		maxTime.storeRelaxed(0);
+	}
+
+	QVariantMap toVariant() const
+	{
+		QVariantMap Entry;
+		Entry["count"] = count.loadRelaxed();
+		Entry["totalTime"] = totalTime.loadRelaxed() / 1000; // us
+		Entry["maxTime"] = maxTime.loadRelaxed() / 1000; // us
+		return Entry;
+	}
+};
+
+struct SV4CustomCommand {
+	CV4ScriptDebuggerBackend::FCommandHandler handler;
+	SV4CommandStats stats;
+};
+
+static bool isDroppableEvent(const QVariantMap& Event)
+{
+	QString type = Event["type"].toString();
+	return type == "Trace" || type == "Log";
+}
+
 class CV4ScriptDebuggerBackendPrivate : public QObjectPrivate
 {
 	Q_DECLARE_PUBLIC(CV4ScriptDebuggerBackend)
 public:
 
-	CV4EngineItf*			engine;
-	QPointer<CV4DebugAgent>	debugger;
-	CV4DebugHandler*		handler;
+	CV4EngineItf*			engine = nullptr;
+	QPointer<CV4DebugAgent>	agent;		// installed into the engine, dormant while detached
+	QPointer<CV4DebugAgent>	debugger;	// set while attached
+	CV4DebugHandler*		handler = nullptr;
+	int						maxStringLength = CV4DebugHandler::DefaultMaxStringLength;
 
-	QVariantList			pendingEvents;
+	// trace and log events are queued apart from the others, so the oldest one to drop is always at the head of its queue,
+	// the sequence numbers restore the order in which all were posted
+	struct SQueuedEvent {
+		quint64 seq;
+		QVariantMap event;
+	};
+	QQueue<SQueuedEvent>	pendingEvents;
+	QQueue<SQueuedEvent>	droppableEvents;
+	quint64					nextEventSeq = 0;
+	int						maxPendingEvents = CV4ScriptDebuggerBackend::DefaultMaxPendingEvents;
+	CV4ScriptDebuggerBackend::EEventOverflow eventOverflow = CV4ScriptDebuggerBackend::eDropOldest;
+	int						droppedEvents = 0;
+	bool					subscribed = false;	// the frontend gets events pushed through sendResponse instead of polling for them
+	bool					inRequest = false;	// events raised while handling a request go out after its response
 
 	QSet<qint64>			checkpointScripts;
 	QSet<qint64>			previousCheckpointScripts;
 
 	int						nextScriptObjectSnapshotId;
-	QMap<int, struct SV4Object*> scriptObjectSnapshots;
+	QMap<int, struct SV4ObjectSnapshot*> scriptObjectSnapshots;
 
 	int						nextScriptValueIteratorId;
 	QMap<int, struct SV4ValueIterator*> scriptValueIterators;
+
+	mutable QMutex			commandMutex;	// guards the custom handlers, which may be registered from any thread
+	QHash<QString, QSharedPointer<SV4CustomCommand>> commandHandlers; // a handler unregistered while it runs stays alive until it returns
+	QAtomicInt				customCommands;	// lets the built-in commands skip the lookup
+	SV4CommandStats			builtinStats[SV4Command::eCount];
+
+	int pendingEventCount() const { return pendingEvents.size() + droppableEvents.size(); }
+	void appendEvent(const QVariantMap& Event) {
+		(isDroppableEvent(Event) ? droppableEvents : pendingEvents).enqueue(SQueuedEvent{ nextEventSeq++, Event });
+	}
+	QVariantMap takeEvent() {
+		if (droppableEvents.isEmpty() || (!pendingEvents.isEmpty() && pendingEvents.head().seq < droppableEvents.head().seq))
+			return pendingEvents.dequeue().event;
+		return droppableEvents.dequeue().event;
+	}
+	SQueuedEvent* lastEvent() {
+		if (!droppableEvents.isEmpty() && droppableEvents.last().seq + 1 == nextEventSeq)
+			return &droppableEvents.last();
+		if (!pendingEvents.isEmpty() && pendingEvents.last().seq + 1 == nextEventSeq)
+			return &pendingEvents.last();
+		return nullptr;
+	}
+	void clearEvents() {
+		pendingEvents.clear();
+		droppableEvents.clear();
+	}
 };
 
 CV4ScriptDebuggerBackend::CV4ScriptDebuggerBackend(QObject *parent)
@@ -82,7 +284,7 @@ void CV4ScriptDebuggerBackend::clear()
 	d->checkpointScripts.clear();
 	d->previousCheckpointScripts.clear();
 
-	foreach(SV4Object * snap, d->scriptObjectSnapshots)
+	foreach(SV4ObjectSnapshot * snap, d->scriptObjectSnapshots)
 		delete snap;
 
 	foreach(SV4ValueIterator * iter, d->scriptValueIterators)
@@ -98,11 +300,33 @@ QVariant CV4ScriptDebuggerBackend::handleRequest(const QVariant& var)
 	{
 		if (in["Control"] == "PullEvent")
 		{
+			pullLogRecords();
+			reportDroppedEvents();
+
 			QVariantMap out;
-			if (!d->pendingEvents.isEmpty())
-				out["Event"] = d->pendingEvents.takeFirst();
+			if (in["All"].toBool()) { // drain the whole queue in one reply
+				QVariantList Events;
+				Events.reserve(d->pendingEventCount());
+				while (d->pendingEventCount() > 0)
+					Events.append(d->takeEvent());
+				if (!Events.isEmpty())
+					out["Events"] = Events;
+			}
+			else if (d->pendingEventCount() > 0)
+				out["Event"] = d->takeEvent();
 			return out;
 		}
+		else if (in["Control"] == "Subscribe")
+		{
+			// a transport which carries sendResponse back on its own can do without polling,
+			// frontends which never see the acknowledgement keep polling
+			d->subscribed = true;
+
+			QVariantMap out;
+			out["Subscribed"] = true;
+			out["Batch"] = true; // also tell the frontend it may send several commands at once
+			return out;
+		}
 		else if (in["Control"] == "Detach")
 		{
 			detach();
@@ -115,6 +339,24 @@ QVariant CV4ScriptDebuggerBackend::handleRequest(const QVariant& var)
 		QVariantMap out;
 		out["ID"] = id;
 		out["Result"] = onCommand(id, in["Command"].toMap());
+		return out;
+	}
+	else if (in.contains("Batch"))
+	{
+		// the commands run one after the other and their results go back in one reply, saving a round trip per command on slow links
+		QVariantList Results;
+		foreach(const QVariant& entry, in["Batch"].toList()) {
+			QVariantMap Command = entry.toMap();
+			qint32 id = Command["ID"].toUInt();
+
+			QVariantMap Result;
+			Result["ID"] = id;
+			Result["Result"] = onCommand(id, Command["Command"].toMap());
+			Results.append(Result);
+		}
+
+		QVariantMap out;
+		out["Results"] = Results;
 		return out;
 	}
 	else if (in.contains("Request"))
@@ -128,15 +370,99 @@ QVariant CV4ScriptDebuggerBackend::handleRequest(const QVariant& var)
 
 void CV4ScriptDebuggerBackend::processRequest(const QVariant& var)
 {
-	emit sendResponse(handleRequest(var));
+	Q_D(CV4ScriptDebuggerBackend);
+
+	d->inRequest = true;
+	QVariant out = handleRequest(var);
+	d->inRequest = false;
+	emit sendResponse(out);
+
+	flushEvents();
+}
+
+void CV4ScriptDebuggerBackend::postEvent(const QVariantMap& Event)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	if (d->maxPendingEvents >= 0 && d->pendingEventCount() >= d->maxPendingEvents && !makeRoomForEvent(Event))
+		return;
+	d->appendEvent(Event);
+	if (!d->inRequest) // a command's response must arrive before the events it caused, e.g. InlineEvalFinished
+		flushEvents();
+}
+
+bool CV4ScriptDebuggerBackend::makeRoomForEvent(const QVariantMap& Event)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	// returns false when the event was merged into the queue or dropped
+
+	if (d->eventOverflow == eCoalesceTraces && Event["type"] == "Trace") {
+		CV4ScriptDebuggerBackendPrivate::SQueuedEvent* Last = d->lastEvent();
+		if (Last && Last->event["type"] == "Trace") {
+			QVariantMap Attributes = Last->event["attributes"].toMap();
+			QString Message = Attributes["message"].toString();
+			QString Append = Event["attributes"].toMap()["message"].toString();
+			if (Message.length() + 1 + Append.length() > MaxCoalescedTrace) { // a trace flood must not grow one message without bound
+				d->droppedEvents++;
+				return false;
+			}
+			Attributes["message"] = Message + "\n" + Append;
+			Last->event["attributes"] = Attributes;
+			return false;
+		}
+	}
+
+	if (!d->droppableEvents.isEmpty()) {
+		d->droppableEvents.dequeue();
+		d->droppedEvents++;
+		return true;
+	}
+
+	// the queue holds only pause events, these must not get lost, so a new trace or log event is dropped instead
+	if (isDroppableEvent(Event)) {
+		d->droppedEvents++;
+		return false;
+	}
+	return true;
+}
+
+void CV4ScriptDebuggerBackend::reportDroppedEvents()
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	if (!d->droppedEvents)
+		return;
+
+	QVariantMap Event;
+	Event["type"] = "Trace";
+	QVariantMap Attributes;
+	Attributes["message"] = tr("%1 debugger events were dropped").arg(d->droppedEvents);
+	Event["attributes"] = Attributes;
+	d->droppedEvents = 0;
+
+	d->appendEvent(Event); // may exceed the limit by this one
+}
+
+void CV4ScriptDebuggerBackend::flushEvents()
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	if (!d->subscribed)
+		return;
+
+	reportDroppedEvents();
+	while (d->pendingEventCount() > 0) {
+		QVariantMap out;
+		out["Event"] = d->takeEvent();
+		emit sendResponse(out);
+	}
 }
 
 QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Command)
 {
 	Q_D(CV4ScriptDebuggerBackend);
 
-	QVariantMap Response;
-
 	QString typeStr = Command["type"].toString();
 	QVariantMap Attributes = Command["attributes"].toMap();
 
@@ -146,7 +472,40 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 	//qDebug() << "cmd: " << typeStr;
 #endif
 
-	if (!d->debugger) {
+	QElapsedTimer timer;
+	timer.start();
+
+	QSharedPointer<SV4CustomCommand> custom;
+	if (d->customCommands.loadAcquire()) {
+		QMutexLocker locker(&d->commandMutex);
+		custom = d->commandHandlers.value(typeStr);
+	}
+
+	QVariantMap Response;
+	SV4CommandStats* stats = nullptr;
+	if (custom) { // custom handlers take precedence over the built-in commands
+		Response = custom->handler(id, Attributes);
+		stats = &custom->stats;
+	}
+	else {
+		SV4Command::EType Type = SV4Command::fromString(typeStr);
+		Response = runCommand(id, Type, Attributes);
+		if (Type != SV4Command::eUnknown) // unknown types are not tracked, or a misbehaving frontend could grow the stats without bound
+			stats = &d->builtinStats[Type];
+	}
+	if (stats)
+		stats->record(timer.nsecsElapsed());
+
+	return Response;
+}
+
+QVariantMap CV4ScriptDebuggerBackend::runCommand(int id, int type, const QVariantMap& Attributes)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	QVariantMap Response;
+
+	if (!d->debugger && !activate()) {
 		Response["error"] = "DetachedError";
 		return Response;
 	}
@@ -160,38 +519,53 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		qDebug() << "V4DebugAgent moved to engine's thread";
 	}
 
-	
-	if (typeStr == "Interrupt")
+	SV4Command::EType Type = SV4Command::EType(type);
+	switch (Type)
+	{
+	case SV4Command::eInterrupt:
 	{
 		d->debugger->pause();
+		break;
 	}
-	else if (typeStr == "Continue" || typeStr == "StepInto" || typeStr == "StepOver" || typeStr == "StepOut" || typeStr == "Resume")
+	case SV4Command::eContinue:
+	case SV4Command::eStepInto:
+	case SV4Command::eStepOver:
+	case SV4Command::eStepOut:
+	case SV4Command::eResume:
 	{
 		CV4DebugAgent::Stepping stepping = CV4DebugAgent::NotStepping;
-		if (typeStr == "StepInto")
+		if (Type == SV4Command::eStepInto)
 			stepping = CV4DebugAgent::StepIn;
-		else if (typeStr == "StepOver")
+		else if (Type == SV4Command::eStepOver)
 			stepping = CV4DebugAgent::StepOver;
-		else if (typeStr == "StepOut")
+		else if (Type == SV4Command::eStepOut)
 			stepping = CV4DebugAgent::StepOut;
+		if (d->debugger->isPaused()) { // let the engine collect the values we looked at, unless the frontend pinned them
+			QSharedPointer<CV4ReleaseRefsJob> job(new CV4ReleaseRefsJob(d->handler));
+			if (!d->debugger->runJobInEngine(job)) // the refs stay valid until the next resume, which does no harm
+				qWarning() << "V4DebugAgent failed to release the refs before resuming";
+		}
 		d->debugger->resume(stepping);
 		Response["async"] = true;
+		break;
 	}
 	
-	else if (typeStr == "RunToLocation" || typeStr == "RunToLocationByID")
+	case SV4Command::eRunToLocation:
+	case SV4Command::eRunToLocationByID:
 	{
 		int lineNumber = Attributes["lineNumber"].toInt();
 		QString fileName;
-		if (typeStr == "RunToLocationByID") {
+		if (Type == SV4Command::eRunToLocationByID) {
 			quint64 scriptId = Attributes["scriptId"].toULongLong();
 			fileName = d->engine->getScriptName(scriptId);
 		} else
 			fileName = Attributes["fileName"].toString();
 		d->debugger->runUntil(fileName, lineNumber);
 		Response["async"] = true;
+		break;
 	}
 	
-	else if (typeStr == "Evaluate")
+	case SV4Command::eEvaluate:
 	{
 		int contextIndex = Attributes["contextIndex"].toInt();
 		QString fileName = Attributes["fileName"].toString();
@@ -202,10 +576,12 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		{
 			int frameNr = 0; // todo
 
-			// Note: this mode is blocking - use only fast to evaluate expressions !!!
-			CV4RunScriptJob job(d->debugger->engine(), d->handler, program, frameNr/*, -1*/);
-			d->debugger->runJobInEngine(&job);
-			evalFinished(job.returnValue().toVariant(), job.exceptionMessage());
+			// Note: this mode is blocking - use only fast to evaluate expressions, slow ones get interrupted !!!
+			QSharedPointer<CV4RunScriptJob> job(new CV4RunScriptJob(d->debugger->engine(), d->handler, program, frameNr/*, -1*/));
+			if (d->debugger->runJobInEngine(job))
+				evalFinished(job->returnValue().toVariant(), job->exceptionMessage());
+			else
+				evalFinished(QVariant(), "Evaluation timed out");
 		}
 		else
 		{
@@ -213,32 +589,37 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 			QMetaObject::invokeMethod(d->engine->self(), "evaluateScript", Qt::QueuedConnection, Q_ARG(QString, program), Q_ARG(QString, fileName), Q_ARG(int, lineNumber));
 		}
 		Response["async"] = true;
+		break;
 	}
-	else if (typeStr == "ForceReturn") // Used only in console commands
+	case SV4Command::eForceReturn: // Used only in console commands
 	{
 		// does not seam to be supported by the V4 engine
+		break;
 	}
 
-	else if (typeStr == "SetBreakpoint")
+	case SV4Command::eSetBreakpoint:
 	{
 		QVariantMap in = Attributes["breakpointData"].toMap();
 
 		SV4Breakpoint bp;
 		bp.fromVariant(in);
-		if (quint64 scriptId = in["scriptId"].toLongLong())
-			bp.fileName = d->engine->getScriptName(scriptId);
+		if (bp.scriptId != -1)
+			bp.fileName = d->engine->getScriptName(bp.scriptId);
 
 		Response["result"] = d->debugger->setBreakpoint(bp);
+		break;
 	}
-	else if (typeStr == "DeleteBreakpoint")
+	case SV4Command::eDeleteBreakpoint:
 	{
 		d->debugger->deleteBreakpoint(Attributes["breakpointId"].toInt());
+		break;
 	}
-	else if (typeStr == "DeleteAllBreakpoints")
+	case SV4Command::eDeleteAllBreakpoints:
 	{
 		d->debugger->deleteAllBreakpoints();
+		break;
 	}
-	else if (typeStr == "GetBreakpoints")
+	case SV4Command::eGetBreakpoints:
 	{
 		QVariantList result;
 		QMap<int, SV4Breakpoint> breakpoints = d->debugger->getBreakpoints();
@@ -246,13 +627,15 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		{
 			QVariantMap out = I.value().toVariant();
 			out["id"] = I.key();
-			out["scriptId"] = d->engine->getScriptId(I.value().fileName);
+			if (I.value().scriptId == -1) // placed by name, the script may have been loaded since
+				out["scriptId"] = d->engine->getScriptId(I.value().fileName);
 			result.append(out);
 		}
 		Response["result"] = result;
 		Response["type"] = "QScriptBreakpointMap";
+		break;
 	}
-	else if (typeStr == "GetBreakpointData")
+	case SV4Command::eGetBreakpointData:
 	{
 		QMap<int, SV4Breakpoint> breakpoints = d->debugger->getBreakpoints();
 		auto I = breakpoints.find(Attributes["breakpointId"].toInt());
@@ -260,26 +643,29 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		{
 			QVariantMap out = I.value().toVariant();
 			out["id"] = I.key();
-			out["scriptId"] = d->engine->getScriptId(I.value().fileName);
+			if (I.value().scriptId == -1)
+				out["scriptId"] = d->engine->getScriptId(I.value().fileName);
 			Response["result"] = out;
 			Response["type"] = "QScriptBreakpointData";
 		}  else
 			Response["error"] = "InvalidBreakpointID";
+		break;
 	}
-	else if (typeStr == "SetBreakpointData")
+	case SV4Command::eSetBreakpointData:
 	{
 		QVariantMap in = Attributes["breakpointData"].toMap();
 
 		SV4Breakpoint bp;
 		bp.fromVariant(in);
-		if (quint64 scriptId = in["scriptId"].toLongLong())
-			bp.fileName = d->engine->getScriptName(scriptId);
+		if (bp.scriptId != -1)
+			bp.fileName = d->engine->getScriptName(bp.scriptId);
 
 		if(!d->debugger->updateBreakpoint(Attributes["breakpointId"].toInt(), bp))
 			Response["error"] = "InvalidBreakpointID";
+		break;
 	}
 
-	else if (typeStr == "GetScriptData")
+	case SV4Command::eGetScriptData:
 	{
 		quint64 scriptId = Attributes["scriptId"].toULongLong();
 		if (scriptId >= d->engine->getScriptCount()) {
@@ -295,18 +681,19 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 
 		Response["result"] = Result;
 		Response["type"] = "QScriptScriptData";
+		break;
 	}
-	else if (typeStr == "ResolveScript") // used only in console commands
+	case SV4Command::eResolveScript: // used only in console commands
 	{
 		Response["result"] = d->engine->getScriptId(Attributes["fileName"].toString());
+		break;
 	}
-	else if (typeStr == "GetScripts") // used only in console commands: .info scripts
+	case SV4Command::eGetScripts: // used only in console commands: .info scripts
 	{
 		QVariantList Scripts;
-		//for(int i=0; i < d->engine->getScriptCount(); i++)
-		foreach(const QString& fileName, d->debugger->getCurrentScripts())
+		//for(int i=0; i < d->engine->getScriptCount(); i++)
+		foreach(qint64 i, d->debugger->getCurrentScripts())
 		{
-			int i = d->engine->getScriptId(fileName);
 			QVariantMap Result;
 			Result["id"] = i;
 			Result["contents"] = d->engine->getScriptSource(i);
@@ -317,58 +704,61 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		}
 		Response["result"] = Scripts;
 		Response["type"] = "QScriptScriptMap";
+		break;
 	}
-	else if (typeStr == "ScriptsCheckpoint")
+	case SV4Command::eScriptsCheckpoint:
 	{
 		d->previousCheckpointScripts = d->checkpointScripts;
 		d->checkpointScripts.clear();
 		//for(int i=0; i < d->engine->getScriptCount(); i++)
 		//	d->checkpointScripts.insert(i);
-		foreach(const QString& fileName, d->debugger->getCurrentScripts())
-			d->checkpointScripts.insert(d->engine->getScriptId(fileName));
+		d->checkpointScripts = d->debugger->getCurrentScripts();
 
 		Response["result"] = scriptDelta();
 		Response["type"] = "QScriptScriptsDelta";
+		break;
 	}
-	else if (typeStr == "GetScriptsDelta")
+	case SV4Command::eGetScriptsDelta:
 	{
 		Response["result"] = scriptDelta();
 		Response["type"] = "QScriptScriptsDelta";
+		break;
 	}
 
-	else if (typeStr == "GetBacktrace") // used only in console commands: .backtrace
+	case SV4Command::eGetBacktrace: // used only in console commands: .backtrace
 	{
-		QVector<QV4::StackFrame> frames = d->debugger->stackTrace();
+		// Note: for deep stacks the trace can be requested in pages, by default the whole stack is returned
+		int from = Attributes.value("contextIndex", 0).toInt();
+		int count = Attributes.value("count", -1).toInt();
 
 		QStringList Backtrace;
-		foreach(const QV4::StackFrame& entry, frames)
-			Backtrace.append(QString("%1() at %2:%3").arg(entry.function.isEmpty() ? "<anonymous>" : entry.function).arg(QUrl(entry.source).fileName()).arg(entry.line));
+		foreach(const SV4StackFrame& entry, d->debugger->stackFrames(from, count))
+			Backtrace.append(QString("%1() at %2:%3").arg(entry.function.isEmpty() ? "<anonymous>" : entry.function).arg(entry.fileName).arg(entry.lineNumber));
 		Response["result"] = Backtrace;
+		break;
 	}
-	else if (typeStr == "GetContextCount") // used only in console commands
+	case SV4Command::eGetContextCount: // used only in console commands
 	{
-		QVector<QV4::StackFrame> frames = d->debugger->stackTrace();
-
-		Response["result"] = frames.count();
+		Response["result"] = d->debugger->frameCount();
+		break;
 	}
 
-	else if (typeStr == "GetContextInfo")
+	case SV4Command::eGetContextInfo:
 	{
-		QVector<QV4::StackFrame> frames = d->debugger->stackTrace();
-
 		int frameNr = Attributes["contextIndex"].toInt();
-		if(frameNr >= frames.size())
+		QVector<SV4StackFrame> frames = d->debugger->stackFrames(frameNr, 1);
+		if(frames.isEmpty())
 			Response["error"] = "InvalidContextIndex";
 		else
 		{
-			QV4::StackFrame& frame = frames[frameNr];
+			const SV4StackFrame& frame = frames.first();
 
 			QVariantMap Result;
-			Result["scriptId"] = d->engine->getScriptId(QUrl(frame.source).fileName());
-			Result["lineNumber"] = frame.line;
-			Result["columnNumber"] = frame.column;
+			Result["scriptId"] = frame.scriptId;
+			Result["lineNumber"] = frame.lineNumber;
+			Result["columnNumber"] = frame.columnNumber;
 
-			Result["fileName"] = QUrl(frame.source).fileName();
+			Result["fileName"] = frame.fileName;
 			Result["functionName"] = frame.function;
 
 			//QJsonArray scopes;
@@ -387,26 +777,30 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 			Response["result"] = Result;
 			Response["type"] = "QScriptDebuggerContextInfo";
 		}
+		break;
 	}
-	else if (typeStr == "GetContextState")
+	case SV4Command::eGetContextState:
 	{
 		//int frameNr = Attributes["contextIndex"].toInt();
 		Response["result"] = d->debugger->engine()->hasException ? 1 : 0;
+		break;
 	}
-	else if (typeStr == "GetContextID")
+	case SV4Command::eGetContextID:
 	{
 		//int frameNr = Attributes["contextIndex"].toInt();
 		Response["result"] = 0;
+		break;
 	}
-	else if (typeStr == "ContextsCheckpoint")
+	case SV4Command::eContextsCheckpoint:
 	{
 		QVariantMap Result;
 		Result["added"] = QVariantList();
 		Result["removed"] = QVariantList();
 		Response["result"] = Result;
 		Response["type"] = "QScriptContextsDelta";
+		break;
 	}
-	else if (typeStr == "GetThisObject")
+	case SV4Command::eGetThisObject:
 	{
 		int frameNr = Attributes["contextIndex"].toInt();
 
@@ -414,11 +808,15 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		Handle.type = UV4Handle::eThis;
 		Handle.frame = frameNr;
 
-		CV4GetPropsJob job(d->handler, Handle);
-		d->debugger->runJobInEngine(&job);
-		SV4Object object = job.returnValue();
+		QSharedPointer<CV4GetPropsJob> job(new CV4GetPropsJob(d->handler, Handle));
+		if (!d->debugger->runJobInEngine(job) || !job->wasSuccessful()) {
+			Response["error"] = "InvalidContextIndex";
+			return Response;
+		}
+		SV4Object object = job->returnValue();
 		
 		Handle.type = UV4Handle::eObject;
+		Handle.generation = object.generation;
 		Handle.ref = object.ref;
 
 		QVariantMap Value;
@@ -426,8 +824,9 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		Value["value"] = Handle.value;
 		Response["result"] = Value;
 		Response["type"] = "QScriptDebuggerValue";
+		break;
 	}
-	else if (typeStr == "GetScopeChain")
+	case SV4Command::eGetScopeChain:
 	{
 		int frameNr = Attributes["contextIndex"].toInt();
 
@@ -461,9 +860,10 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		Response["result"] = Result;
 		//Response["type"] = "QScriptDebuggerValueList";
 		Response["type"] = "QScriptDebuggerValuePropertyList";
+		break;
 	}
 	
-	else if (typeStr == "GetActivationObject") // used only in console commands: .info locals
+	case SV4Command::eGetActivationObject: // used only in console commands: .info locals
 	{
 		int frameNr = Attributes["contextIndex"].toInt();
 
@@ -484,99 +884,85 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 
 		Response["result"] = Value;
 		Response["type"] = "QScriptDebuggerValue";
+		break;
 	}
 
-	else if (typeStr == "GetPropertyExpressionValue") // irrelevant used only for tooltips
-		; 
-	else if (typeStr == "GetCompletions") // irrelevant used only for autocomplete
-		; 
+	case SV4Command::eGetPropertyExpressionValue: // irrelevant used only for tooltips
+	case SV4Command::eGetCompletions: // irrelevant used only for autocomplete
+		break;
 		
-	else if (typeStr == "NewScriptObjectSnapshot")
+	case SV4Command::eNewScriptObjectSnapshot:
 	{
 		int snap_id = d->nextScriptObjectSnapshotId;
 		++d->nextScriptObjectSnapshotId;
-		d->scriptObjectSnapshots.insert(snap_id, new SV4Object());
+		d->scriptObjectSnapshots.insert(snap_id, new SV4ObjectSnapshot());
 		Response["result"] = snap_id;
+		break;
 	}
-	else if (typeStr == "ScriptObjectSnapshotCapture")
+	case SV4Command::eScriptObjectSnapshotCapture:
 	{
 		QVariantMap value = Attributes["scriptValue"].toMap();
 		Q_ASSERT(value["type"] == "ObjectValue"); // as provided by GetScopeChain
 		UV4Handle Handle = { value["value"].toULongLong() };
 
 		int snap_id = Attributes["snapshotId"].toInt();
-		SV4Object* snap = d->scriptObjectSnapshots.value(snap_id);
+		SV4ObjectSnapshot* snap = d->scriptObjectSnapshots.value(snap_id);
 		Q_ASSERT(snap != 0);
 		if (!snap) {
 			Response["error"] = "InvalidArgumentIndex";
 			return Response;
 		}
-		snap->handle = Handle;
 
-		CV4GetPropsJob job(d->handler, Handle);
-		d->debugger->runJobInEngine(&job);
-		SV4Object object = job.returnValue();
+		// the frontend may only want the first count properties, it asks for more when it shows them
+		int count = Attributes.value("count", -1).toInt();
 
-		QMap<QString, SV4Property> currProps;
-		QHash<QString, int> propertyNameToIndex;
-		for (int i = 0; i < object.properties.size(); i++)
-		{
-			const SV4Property& value = object.properties[i];
-			currProps.insert(value.name, value);
-			propertyNameToIndex.insert(value.name, i);
+		// the refs the frontend holds for an expanded object must survive the next resume
+		QSharedPointer<CV4GetPropsJob> job(new CV4GetPropsJob(d->handler, Handle, 0, count, true));
+		job->setPinned(*snap);
+		if (!d->debugger->runJobInEngine(job) || !job->wasSuccessful()) {
+			Response["error"] = "InvalidArgumentIndex";
+			return Response;
 		}
+		SV4Object object = job->returnValue();
+		snap->handle = Handle;
 
-		QSet<QString> prevSet;
-		for (int i = 0; i < snap->properties.size(); ++i)
-			prevSet.insert(snap->properties.at(i).name);
-		QStringList currProps_keys = currProps.keys();
-		QSet<QString> currSet = QSet<QString>(currProps_keys.begin(), currProps_keys.end());
-		QSet<QString> removedPropertiesSet = prevSet - currSet;
-		QSet<QString> addedPropertiesSet = currSet - prevSet;
-		QSet<QString> maybeChangedPropertiesSet = currSet & prevSet;
-
-		QMap<int, SV4Property> addedPropertiesMap;
-		for (QSet<QString>::const_iterator I = addedPropertiesSet.constBegin(); I != addedPropertiesSet.constEnd(); I++) {
-			int idx = propertyNameToIndex[*I];
-			addedPropertiesMap[idx] = currProps[*I];
+		// one pass over the captured properties against the values of the last capture,
+		// added properties keep the order in which the object enumerates them
+		QVariantList changedProperties;
+		QVariantList addedProperties;
+		QHash<QString, SV4Value> values;
+		values.reserve(object.properties.size());
+		for (const SV4Property& prop : object.properties) {
+			auto I = snap->values.constFind(prop.name);
+			if (I == snap->values.constEnd())
+				addedProperties.append(prop.toVariant());
+			else if (*I != prop)
+				changedProperties.append(prop.toVariant());
+			values.insert(prop.name, prop);
 		}
-		
-		QList<SV4Property> changedPropertiesList;
-		for (QSet<QString>::const_iterator I = maybeChangedPropertiesSet.constBegin(); I != maybeChangedPropertiesSet.constEnd(); I++) {
-			const SV4Property& p1 = currProps[*I];
-			SV4Property p2 = SV4Property();
-			for (int i = 0; i < snap->properties.size(); ++i) {
-				if (snap->properties.at(i).name == *I) {
-					p2 = snap->properties.at(i);
-					break;
-				}
-			}
 
-			if (p1.type != p2.type || p1.data != p2.data)
-				changedPropertiesList.append(p1);
+		QStringList removedProperties;
+		for (auto I = snap->values.constBegin(); I != snap->values.constEnd(); ++I) {
+			if (!values.contains(I.key()))
+				removedProperties.append(I.key());
 		}
 
-		snap->properties = currProps.values().toVector();
-		
+		snap->values = std::move(values);
+		snap->properties = std::move(object.properties);
 
 		QVariantMap result;
-
-		result["removedProperties"] = QStringList(removedPropertiesSet.begin(), removedPropertiesSet.end());
-
-		QVariantList changedProperties;
-		foreach(const SV4Property & value, changedPropertiesList)
-			changedProperties.append(value.toVariant());
+		result["removedProperties"] = removedProperties;
 		result["changedProperties"] = changedProperties;
-
-		QVariantList addedProperties;
-		foreach(const SV4Property& value, addedPropertiesMap)
-			addedProperties.append(value.toVariant());
 		result["addedProperties"] = addedProperties;
+		result["hasMore"] = object.hasMore;
+		if (object.binary.isValid()) // the elements of a typed array go as one block of bytes
+			result["binary"] = object.binary.toVariant();
 
 		Response["result"] = result;
 		Response["type"] = "QScriptDebuggerObjectSnapshotDelta";
+		break;
 	}
-	else if (typeStr == "ScriptValueToString") // used only in console commands
+	case SV4Command::eScriptValueToString: // used only in console commands
 	{
 		QVariantMap value = Attributes["scriptValue"].toMap();
 		Q_ASSERT(value["type"] == "ObjectValue");
@@ -585,8 +971,29 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		// todo
 
 		Response["result"] = "TODO: not implemented";
+		break;
 	}
-	else if (typeStr == "NewScriptValueIterator") // used only in console commands
+	case SV4Command::eGetStringRange:
+	{
+		QVariantMap value = Attributes["scriptValue"].toMap();
+		UV4Handle Handle = { value["ref"].toULongLong() };
+		if (value["type"] != "StringValue" || !value.contains("ref") || Handle.type != UV4Handle::eValue) { // only a truncated string is sent with a ref
+			Response["error"] = "InvalidArgumentIndex";
+			return Response;
+		}
+
+		QSharedPointer<CV4GetStringJob> job(new CV4GetStringJob(d->handler, Handle, Attributes["from"].toInt(), Attributes.value("count", -1).toInt()));
+		bool done = d->debugger->runJobInEngine(job);
+		if (!done || !job->wasSuccessful()) {
+			// the frontend may ask for the rest of a string it got during an earlier pause, its ref is gone by now
+			Response["error"] = done && job->isStale() ? "UserError" : "InvalidArgumentIndex";
+			return Response;
+		}
+
+		Response["result"] = job->returnValue();
+		break;
+	}
+	case SV4Command::eNewScriptValueIterator: // used only in console commands
 	{
 		QVariantMap value = Attributes["scriptValue"].toMap();
 		Q_ASSERT(value["type"] == "ObjectValue"); // as provided by GetScopeChain
@@ -596,19 +1003,21 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		++d->nextScriptValueIteratorId;
 		SV4ValueIterator* iter = new SV4ValueIterator();
 		d->scriptValueIterators.insert(id, iter);
-
-		CV4GetPropsJob job(d->handler, Handle);
-		d->debugger->runJobInEngine(&job);
-		iter->snapshot = job.returnValue();
+		iter->handle = Handle; // the properties are retrieved page by page
 
 		Response["result"] = id;
+		break;
 	}
-	else if (typeStr == "DeleteScriptObjectSnapshot")
+	case SV4Command::eDeleteScriptObjectSnapshot:
 	{
 		int snap_id = Attributes["snapshotId"].toInt();
-		delete d->scriptObjectSnapshots.take(snap_id);
+		SV4ObjectSnapshot* snap = d->scriptObjectSnapshots.take(snap_id);
+		if (snap && d->handler) // the refs are only touched in the engine's thread, no need to wait for it though
+			d->debugger->scheduleJob(QSharedPointer<CV4DebugJob>(new CV4UnpinRefsJob(d->handler, *snap)));
+		delete snap;
+		break;
 	}
-	else if(typeStr == "GetPropertiesByIterator") // used only in console commands
+	case SV4Command::eGetPropertiesByIterator: // used only in console commands
 	{
 		int iter_id = Attributes["iteratorId"].toInt();
 		SV4ValueIterator *iter = d->scriptValueIterators.value(iter_id);
@@ -618,19 +1027,30 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 			return Response;
 		}
 
+		int count = Attributes.value("count", -1).toInt();
+
+		QSharedPointer<CV4GetPropsJob> job(new CV4GetPropsJob(d->handler, iter->handle, iter->index, count));
+		if (!d->debugger->runJobInEngine(job) || !job->wasSuccessful()) {
+			Response["error"] = "InvalidArgumentIndex";
+			return Response;
+		}
+
 		QVariantList Result;
-		for(;iter->index < iter->snapshot.properties.size(); iter->index++)
-			Result.append(iter->snapshot.properties[iter->index].toVariant());
+		for (const SV4Property& prop : job->returnValue().properties)
+			Result.append(prop.toVariant());
+		iter->index += Result.size();
 		Response["result"] = Result;
 		Response["type"] = "QScriptDebuggerValuePropertyList";
+		break;
 	}
-	else if(typeStr == "DeleteScriptValueIterator") // used only in console commands
+	case SV4Command::eDeleteScriptValueIterator: // used only in console commands
 	{
 		int iter_id = Attributes["iteratorId"].toInt();
 		delete d->scriptValueIterators.take(iter_id);
+		break;
 	}
 	
-	else if (typeStr == "SetScriptValueProperty")
+	case SV4Command::eSetScriptValueProperty:
 	{
 		QVariantMap value = Attributes["scriptValue"].toMap();
 		Q_ASSERT(value["type"] == "ObjectValue");
@@ -639,42 +1059,169 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		SV4Value Value;
 		Value.fromVariant(Attributes["subordinateScriptValue"].toMap());
 
-		CV4SetValueJob job(d->handler, Handle, Attributes["name"].toString(), Value);
-		d->debugger->runJobInEngine(&job);
+		QSharedPointer<CV4SetValueJob> job(new CV4SetValueJob(d->handler, Handle, Attributes["name"].toString(), Value));
+		if (!d->debugger->runJobInEngine(job) || !job->wasSuccessful())
+			Response["error"] = "InvalidArgumentIndex";
+		break;
 	}
 
-	else if (typeStr == "ClearExceptions") // used only in console commands
+	case SV4Command::eClearExceptions: // used only in console commands
 	{
 		d->debugger->engine()->hasException = false;
+		break;
 	}
 		
-	else // unknown commands
-	{
+	default: // unknown commands
 		Q_ASSERT(0);
 	}
 
 	return Response;
+}
+
+void CV4ScriptDebuggerBackend::registerCommand(const QString& type, const FCommandHandler& handler)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	QMutexLocker locker(&d->commandMutex);
+	d->commandHandlers.insert(type, QSharedPointer<SV4CustomCommand>(new SV4CustomCommand{ handler }));
+	d->customCommands.storeRelease(d->commandHandlers.size());
+}
+
+void CV4ScriptDebuggerBackend::unregisterCommand(const QString& type)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	QMutexLocker locker(&d->commandMutex);
+	d->commandHandlers.remove(type);
+	d->customCommands.storeRelease(d->commandHandlers.size());
+}
+
+QVariantMap CV4ScriptDebuggerBackend::commandStats() const
+{
+	Q_D(const CV4ScriptDebuggerBackend);
+
+	QVariantMap Stats;
+	for (int i = SV4Command::eUnknown + 1; i < SV4Command::eCount; i++) {
+		if (d->builtinStats[i].count.loadRelaxed())
+			Stats[SV4Command::toString(SV4Command::EType(i))] = d->builtinStats[i].toVariant();
+	}
+
+	QMutexLocker locker(&d->commandMutex);
+	for (auto I = d->commandHandlers.constBegin(); I != d->commandHandlers.constEnd(); ++I) {
+		if ((*I)->stats.count.loadRelaxed())
+			Stats[I.key()] = (*I)->stats.toVariant();
+	}
+	return Stats;
+}
+
+void CV4ScriptDebuggerBackend::resetCommandStats()
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	for (int i = 0; i < SV4Command::eCount; i++)
+		d->builtinStats[i].reset();
+
+	QMutexLocker locker(&d->commandMutex);
+	for (auto I = d->commandHandlers.constBegin(); I != d->commandHandlers.constEnd(); ++I)
+		(*I)->stats.reset();
 }
 
 void CV4ScriptDebuggerBackend::attachTo(class CV4EngineItf* engine)
 {
 	Q_D(CV4ScriptDebuggerBackend);
 
+	//
+	// Note: installing a debugger disables the JIT and makes all newly compiled code carry debug instructions,
+	//	so the backend stays dormant and only installs the agent once a frontend sends its first command
+	//
 	d->engine = engine;
-	d->debugger = new CV4DebugAgent(engine->self()->handle());
-	d->handler = new CV4DebugHandler(engine->self()->handle(), this);
-	connect(d->debugger, SIGNAL(debuggerPaused(CV4DebugAgent*, int, const QString&, int)), this, SLOT(debuggerPaused(CV4DebugAgent*, int, const QString&, int)));
+}
+
+void CV4ScriptDebuggerBackend::setMaxStringLength(int length)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	d->maxStringLength = length;
+	if (d->handler)
+		d->handler->setMaxStringLength(length);
+}
+
+int CV4ScriptDebuggerBackend::maxStringLength() const
+{
+	Q_D(const CV4ScriptDebuggerBackend);
+
+	return d->maxStringLength;
+}
+
+void CV4ScriptDebuggerBackend::setMaxPendingEvents(int count)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	d->maxPendingEvents = count;
+}
+
+int CV4ScriptDebuggerBackend::maxPendingEvents() const
+{
+	Q_D(const CV4ScriptDebuggerBackend);
+
+	return d->maxPendingEvents;
+}
+
+void CV4ScriptDebuggerBackend::setEventOverflow(EEventOverflow overflow)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	d->eventOverflow = overflow;
+}
+
+CV4ScriptDebuggerBackend::EEventOverflow CV4ScriptDebuggerBackend::eventOverflow() const
+{
+	Q_D(const CV4ScriptDebuggerBackend);
+
+	return d->eventOverflow;
+}
+
+bool CV4ScriptDebuggerBackend::activate()
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	if (!d->engine)
+		return false;
+
+	// the engine owns its debugger and can not uninstall it, so when we were attached before we take over the old agent
+	QV4::ExecutionEngine* engine = d->engine->self()->handle();
+	if (!d->agent)
+		d->agent = qobject_cast<CV4DebugAgent*>(engine->debugger());
+	if (!d->agent) {
+		// the engine may be running script, so the agent gets installed from within the engine's thread, 
+		//	without waiting for it, its hooks start firing once the engine returns to its event loop
+		d->agent = new CV4DebugAgent(d->engine);
+		d->agent->moveToThread(d->engine->self()->thread());
+		QPointer<CV4DebugAgent> agent = d->agent;
+		QMetaObject::invokeMethod(d->agent, [agent]() {
+			if (agent)
+				agent->install();
+		}, Qt::QueuedConnection);
+	}
+	d->debugger = d->agent;
+	d->debugger->setAttached(true);
+	d->handler = new CV4DebugHandler(engine, this);
+	d->handler->setMaxStringLength(d->maxStringLength);
+	connect(d->debugger, SIGNAL(debuggerPaused(CV4DebugAgent*, int, qint64, const QString&, int)), this, SLOT(debuggerPaused(CV4DebugAgent*, int, qint64, const QString&, int)));
+	connect(d->debugger, SIGNAL(logRecordsAvailable()), this, SLOT(logRecordsAvailable()));
 	connect(d->engine->self(), SIGNAL(evaluateFinished(const QJSValue&)), this, SLOT(evaluateFinished(const QJSValue&)));
 	connect(d->engine->self(), SIGNAL(printTrace(const QString&)), this, SLOT(printTrace(const QString&)));
 	connect(d->engine->self(), SIGNAL(invokeDebugger()), this, SLOT(invokeDebugger()), Qt::BlockingQueuedConnection);
 	d->debugger->setBreakOnException();
+	return true;
 }
 
 void CV4ScriptDebuggerBackend::pause()
 {
 	Q_D(CV4ScriptDebuggerBackend);
 
-	d->debugger->pause();
+	if (d->debugger || activate())
+		d->debugger->pause();
 }
 
 void CV4ScriptDebuggerBackend::detach()
@@ -687,17 +1234,25 @@ void CV4ScriptDebuggerBackend::detach()
 	d->debugger->resume(); // clear stepping
 	d->debugger->setBreakOnException(false); // clear break on exception
 	d->debugger->deleteAllBreakpoints(); // clear breakpoints
+	d->debugger->setAttached(false); // go dormant, the engine keeps running in the interpreter though
 	d->debugger->resume(); // final resume
-	d->debugger = NULL; // the engine will dispose of the debugger
-
-	delete d->handler;
+
+	// an abandoned job may still be using the handler, so it gets deleted in the engine's thread after all queued jobs
+	d->handler->setParent(nullptr);
+	d->handler->moveToThread(d->engine->self()->thread());
+	d->debugger->scheduleJob(QSharedPointer<CV4DebugJob>(new CV4DeleteHandlerJob(d->handler)));
 	d->handler = NULL;
+
+	disconnect(d->debugger, nullptr, this, nullptr);
+	d->debugger = NULL; // the agent stays installed, the engine will dispose of it
 
-	disconnect(this);
-	d->engine = NULL;
+	disconnect(d->engine->self(), nullptr, this, nullptr);
+	d->clearEvents();
+	d->subscribed = false; // a new frontend polls until it subscribes again
+	d->inRequest = false;
 }
 
-void CV4ScriptDebuggerBackend::debuggerPaused(CV4DebugAgent* debugger, int reason, const QString& fileName, int lineNumber)
+void CV4ScriptDebuggerBackend::debuggerPaused(CV4DebugAgent* debugger, int reason, qint64 scriptId, const QString& fileName, int lineNumber)
 {
 	Q_D(CV4ScriptDebuggerBackend);
 
@@ -714,27 +1269,24 @@ void CV4ScriptDebuggerBackend::debuggerPaused(CV4DebugAgent* debugger, int reaso
 	case CV4DebugAgent::Exception:		Event["type"] = "Exception"; break;
 	}
 	QVariantMap Attributes;
-	Attributes["scriptId"] = d->engine->getScriptId(QUrl(fileName).fileName());
-	Attributes["fileName"] = QUrl(fileName).fileName();
+	Attributes["scriptId"] = scriptId;
+	Attributes["fileName"] = fileName; // from the frame, the script may not be tracked
 	Attributes["lineNumber"] = lineNumber;
 	Attributes["columnNumber"] = 0; // todo
 	if (reason == CV4DebugAgent::Exception) 
 	{
-		QV4::Scope scope(d->debugger->engine());
-		QV4::ScopedValue ex(scope);
-		quint8 hadException = scope.engine->hasException;
-		scope.engine->hasException = false;
-		QV4::ScopedValue prim(scope, QV4::RuntimeHelpers::toPrimitive(scope.engine->exceptionValue->asReturnedValue(), QV4::STRING_HINT));
-		scope.engine->hasException = hadException;
-        if (prim->isPrimitive())
-            Attributes["message"] = prim->toQStringNoThrow();
-		//Attributes["message"] = scope.engine->exceptionValue->toQStringNoThrow(); // warning this clears the exception
-		Attributes["value"] = d->engine->self()->toScriptValue(scope.engine->exceptionValue).toVariant();
+		// only the message and a ref are sent, the exception object is expanded when the frontend asks for it
+		QSharedPointer<CV4GetExceptionJob> job(new CV4GetExceptionJob(d->handler));
+		if (d->debugger->runJobInEngine(job)) {
+			if (!job->exceptionMessage().isNull())
+				Attributes["message"] = job->exceptionMessage();
+			Attributes["value"] = job->returnValue().toVariant();
+		}
 		Attributes["hasExceptionHandler"] = true; // todo
 	}
 	Event["attributes"] = Attributes;
 
-	d->pendingEvents.append(Event);
+	postEvent(Event);
 }
 
 void CV4ScriptDebuggerBackend::evaluateFinished(const QJSValue& ret)
@@ -761,7 +1313,7 @@ void CV4ScriptDebuggerBackend::evalFinished(const QVariant& Value, const QString
 	Attributes["message"] = Message;
 	Event["attributes"] = Attributes;
 
-	d->pendingEvents.append(Event);
+	postEvent(Event);
 }
 
 void CV4ScriptDebuggerBackend::printTrace(const QString& Message)
@@ -774,9 +1326,54 @@ void CV4ScriptDebuggerBackend::printTrace(const QString& Message)
 	Attributes["message"] = Message;
 	Event["attributes"] = Attributes;
 
-	d->pendingEvents.append(Event);
+	postEvent(Event);
 }
 
+void CV4ScriptDebuggerBackend::pullLogRecords()
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	if (!d->debugger)
+		return;
+
+	// drain the logpoint records in one batch
+	d->debugger->rearmLogRecords();
+	QVariantList Records;
+	SV4LogRecord record;
+	while (d->debugger->takeLogRecord(record))
+	{
+		QVariantMap Record;
+		Record["timeStamp"] = record.timeStamp;
+		Record["engine"] = d->engine->self()->objectName();
+		Record["scriptId"] = record.scriptId;
+		Record["fileName"] = d->engine->getScriptName(record.scriptId);
+		Record["lineNumber"] = record.lineNumber;
+		Record["message"] = record.message;
+		Records.append(Record);
+	}
+	int dropped = d->debugger->takeDroppedLogRecords();
+	if (Records.isEmpty() && !dropped)
+		return;
+
+	QVariantMap Event;
+	Event["type"] = "Log";
+	QVariantMap Attributes;
+	Attributes["records"] = Records;
+	if (dropped)
+		Attributes["message"] = tr("%1 log records were dropped").arg(dropped);
+	Event["attributes"] = Attributes;
+
+	postEvent(Event);
+}
+
+void CV4ScriptDebuggerBackend::logRecordsAvailable()
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	if (d->subscribed) // polling frontends get them with their next PullEvent
+		pullLogRecords();
+}
+
 void CV4ScriptDebuggerBackend::invokeDebugger()
 {
 	Q_D(CV4ScriptDebuggerBackend);
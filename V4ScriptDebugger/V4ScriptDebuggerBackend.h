@@ -30,13 +30,24 @@
 
 #include <QJSEngine>
 
+#include <functional>
+
 class CV4DebugAgent;
 
 class CV4ScriptDebuggerBackendPrivate;
 class V4SCRIPTDEBUGGER_EXPORT CV4ScriptDebuggerBackend : public QObject
 {
     Q_OBJECT
+    Q_PROPERTY(int maxStringLength READ maxStringLength WRITE setMaxStringLength) // settable through QObject::setProperty when loaded dynamically
+    Q_PROPERTY(int maxPendingEvents READ maxPendingEvents WRITE setMaxPendingEvents)
+    Q_PROPERTY(EEventOverflow eventOverflow READ eventOverflow WRITE setEventOverflow)
 public:
+	enum EEventOverflow {
+		eDropOldest = 0,	// drop the oldest queued trace and log events
+		eCoalesceTraces		// merge new trace messages into the last queued trace event, up to MaxCoalescedTrace characters
+	};
+	Q_ENUM(EEventOverflow)
+
 	CV4ScriptDebuggerBackend(QObject *parent = 0);
     ~CV4ScriptDebuggerBackend();
 
@@ -45,6 +56,26 @@ public:
 	QVariantMap onCommand(int id, const QVariantMap& Command);
 	void attachTo(class CV4EngineItf* engine);
 
+	// a registered handler runs in the backend's thread instead of the built-in command of that type, or serves a new command type
+	typedef std::function<QVariantMap(int id, const QVariantMap& Attributes)> FCommandHandler;
+	void registerCommand(const QString& type, const FCommandHandler& handler);
+	void unregisterCommand(const QString& type);
+
+	// for diagnostics: command type -> { count, totalTime, maxTime }, times in microseconds
+	QVariantMap commandStats() const;
+	void resetCommandStats();
+
+	// strings longer than this are sent as a prefix, the frontend fetches the rest on request, -1 sends them whole
+	void setMaxStringLength(int length);
+	int maxStringLength() const;
+
+	// events wait here until the frontend pulls them, when the queue is full trace and log events make room, pause events are always kept
+	enum { DefaultMaxPendingEvents = 1000, MaxCoalescedTrace = 64 * 1024 }; // events, characters
+	void setMaxPendingEvents(int count);
+	int maxPendingEvents() const;
+	void setEventOverflow(EEventOverflow overflow);
+	EEventOverflow eventOverflow() const;
+
 signals:
 	void sendResponse(const QVariant& var);
 
@@ -54,18 +85,26 @@ public slots:
 	void processRequest(const QVariant& var);
 
 private slots:
-    void debuggerPaused(CV4DebugAgent* debugger, int reason, const QString& fileName, int lineNumber);
+    void debuggerPaused(CV4DebugAgent* debugger, int reason, qint64 scriptId, const QString& fileName, int lineNumber);
     void evaluateFinished(const QJSValue& ret);
     void printTrace(const QString& Message);
 	void invokeDebugger();
+	void logRecordsAvailable();
 
 protected:
 	virtual QVariant handleCustom(const QVariant& var) {return QVariant();}
 	virtual void requestStart() {}
 
+    QVariantMap runCommand(int id, int type, const QVariantMap& Attributes); // type is a built-in command type
     void evalFinished(const QVariant& Value, const QString& Message = QString());
+    void postEvent(const QVariantMap& Event);
+    bool makeRoomForEvent(const QVariantMap& Event);
+    void reportDroppedEvents();
+    void flushEvents();
 	
+    bool activate();
     QVariantMap scriptDelta();
+    void pullLogRecords();
     void clear();
 
 private: